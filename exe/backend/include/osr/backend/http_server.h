@@ -1,5 +1,7 @@
 #pragma once
 
+#include <chrono>
+#include <filesystem>
 #include <memory>
 #include <string>
 
@@ -11,13 +13,35 @@
 
 namespace osr::backend {
 
+struct server_config {
+  // Byte budget of the route response cache (0 = disabled).
+  std::size_t route_cache_bytes_{64U * 1024U * 1024U};
+  unsigned cache_shards_{16U};
+
+  // Admission control: requests beyond these limits get HTTP 503 (0 = off).
+  std::size_t max_queued_requests_{1024U};
+  unsigned max_concurrent_route_{0U};
+  unsigned max_concurrent_route_batch_{0U};
+  unsigned max_concurrent_graph_{0U};
+
+  // Thread pool tasks per /api/route/batch request (0 = one per group).
+  unsigned max_batch_threads_{4U};
+
+  // Searches still running after this time are cancelled (0 = no deadline).
+  std::chrono::milliseconds request_timeout_{std::chrono::seconds{30}};
+
+  // Log API request bodies for osr-replay (empty = off).
+  std::filesystem::path request_log_{};
+};
+
 struct http_server {
   http_server(boost::asio::io_context& ioc,
               boost::asio::io_context& thread_pool,
               ways const&,
               lookup const&,
               platforms const*,
-              std::string const& static_file_path);
+              std::string const& static_file_path,
+              server_config const& = {});
   ~http_server();
   http_server(http_server const&) = delete;
   http_server& operator=(http_server const&) = delete;
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cinttypes>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "osr/routing/profile.h"
+#include "osr/routing/search_stats.h"
+
+namespace osr::backend {
+
+enum class api_endpoint : std::uint8_t {
+  kRoute,
+  kRouteBatch,
+  kLevels,
+  kGraph,
+  kPlatforms
+};
+
+constexpr auto const kNEndpoints = 5U;
+
+std::string_view to_str(api_endpoint);
+
+enum class request_phase : std::uint8_t {
+  kQueueWait,
+  kMatch,
+  kSearch,
+  kReconstruct,
+  kSerialize,
+  kTotal
+};
+
+constexpr auto const kNPhases = 6U;
+
+std::string_view to_str(request_phase);
+
+// HDR style log-linear histogram over microseconds: values < 2^kSubBits are
+// exact, every larger power of two is split into 2^kSubBits buckets.
+struct histogram_layout {
+  static constexpr auto const kSubBits = 2U;
+  static constexpr auto const kSub = 1U << kSubBits;
+  static constexpr auto const kMaxBits = 36U;  // ~19h
+  static constexpr auto const kNBuckets = (kMaxBits - kSubBits + 1U) * kSub;
+
+  static constexpr std::size_t get_bucket(std::uint64_t const v) {
+    if (v < kSub) {
+      return v;
+    }
+    auto const x = std::min(v, (std::uint64_t{1U} << kMaxBits) - 1U);
+    auto const e = static_cast<unsigned>(std::bit_width(x)) - 1U;
+    return (e - kSubBits + 1U) * kSub + ((x >> (e - kSubBits)) - kSub);
+  }
+
+  // Exclusive upper bound of the values in bucket i.
+  static constexpr std::uint64_t get_upper_bound(std::size_t const i) {
+    if (i < kSub) {
+      return i + 1U;
+    }
+    auto const e = i / kSub + kSubBits - 1U;
+    auto const sub = i % kSub;
+    return (kSub + sub + 1U) << (e - kSubBits);
+  }
+};
+
+// Lock-free on the recording side: every thread writes relaxed atomics in
+// its own shard. Shards are merged when the metrics are scraped.
+struct metrics {
+  metrics();
+  ~metrics();
+
+  metrics(metrics const&) = delete;
+  metrics& operator=(metrics const&) = delete;
+  metrics(metrics&&) = delete;
+  metrics& operator=(metrics&&) = delete;
+
+  void record(api_endpoint,
+              std::optional<search_profile>,
+              request_phase,
+              search_stats::duration_t);
+  void record_search(api_endpoint, search_profile, search_stats const&);
+  void count_response(api_endpoint, unsigned status);
+  void count_rejected(api_endpoint);
+
+  // Prometheus text exposition format.
+  std::string to_prometheus() const;
+
+private:
+  struct shard;
+
+  shard& local();
+
+  std::uint64_t id_;
+  mutable std::mutex mutex_;  // guards shards_ (registration + scrape)
+  std::vector<std::unique_ptr<shard>> shards_;
+};
+
+}  // namespace osr::backend
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string_view>
+
+namespace osr::backend {
+
+// Appends one JSON object per request (JSON lines) for osr-replay:
+// {"time_us": <microseconds since epoch>, "target": "...", "body": "..."}
+struct request_log {
+  explicit request_log(std::filesystem::path const&);
+
+  void write(std::string_view target, std::string_view body);
+  void flush();
+
+private:
+  std::mutex mutex_;
+  std::ofstream out_;
+};
+
+}  // namespace osr::backend
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <cinttypes>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace osr::backend {
+
+// Sharded LRU cache for serialized responses.
+// Every shard evicts its least recently used entries as soon as it exceeds
+// its share of the byte budget. A byte budget of zero disables the cache.
+struct response_cache {
+  using value_t = std::shared_ptr<std::string const>;
+
+  struct stats {
+    std::uint64_t hits_{0U};
+    std::uint64_t misses_{0U};
+    std::uint64_t evictions_{0U};
+    std::uint64_t entries_{0U};
+    std::uint64_t bytes_{0U};
+  };
+
+  response_cache(std::size_t max_bytes, unsigned n_shards);
+  ~response_cache();
+
+  response_cache(response_cache const&) = delete;
+  response_cache& operator=(response_cache const&) = delete;
+  response_cache(response_cache&&) = delete;
+  response_cache& operator=(response_cache&&) = delete;
+
+  bool enabled() const noexcept { return max_bytes_ != 0U; }
+
+  value_t get(std::string const& key);
+  void put(std::string key, std::string value);
+
+  // Drops all entries if the dataset version changed.
+  void set_version(std::uint64_t);
+  std::uint64_t version() const noexcept { return version_; }
+
+  void clear();
+
+  stats get_stats() const;
+
+private:
+  struct shard;
+
+  shard& get_shard(std::string_view key);
+
+  std::size_t max_bytes_;
+  std::vector<std::unique_ptr<shard>> shards_;
+  std::atomic_uint64_t version_{0U};
+  std::atomic_uint64_t hits_{0U}, misses_{0U}, evictions_{0U};
+};
+
+// Identifies the loaded dataset (size + modification time of routing.bin).
+std::uint64_t get_dataset_version(std::filesystem::path const& data_dir);
+
+// Requests that only differ below this resolution share cache entries.
+constexpr auto const kCacheCoordinatePrecision = 1E6;
+
+std::int64_t quantize(double coordinate);
+
+}  // namespace osr::backend
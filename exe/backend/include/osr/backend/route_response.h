@@ -0,0 +1,62 @@
+#pragma once
+
+#include <array>
+#include <cinttypes>
+#include <string>
+#include <string_view>
+
+#include "cista/containers/vector.h"
+
+#include "osr/routing/route.h"
+#include "osr/ways.h"
+
+namespace osr::backend {
+
+enum class route_format : std::uint8_t {
+  kGeoJson,  // boost::json DOM (default)
+  kGeoJsonStream,  // same output, written without intermediate DOM
+  kPolyline,  // JSON with Google encoded polyline per segment
+  kBinary  // cista serialized route_binary
+};
+
+route_format to_route_format(std::string_view);
+
+char const* get_content_type(route_format);
+
+// Layout of the kBinary response (cista::offset mode, no integrity checks).
+// Coordinates are [lng, lat] in 1e-7 degrees. Segment i covers the
+// coordinates [segments_[i-1].coordinates_end_, coordinates_end_).
+struct route_binary {
+  struct segment {
+    std::uint64_t osm_way_id_;
+    float level_;
+    cost_t cost_;
+    distance_t distance_;
+    std::uint32_t coordinates_end_;
+  };
+
+  cost_t duration_;
+  double distance_;
+  cista::offset::vector<segment> segments_;
+  cista::offset::vector<std::array<std::int32_t, 2>> coordinates_;
+};
+
+std::string write_geojson(ways const&, path const&, bool with_stats);
+
+std::string write_geojson_stream(ways const&, path const&, bool with_stats);
+
+std::string write_polyline(ways const&,
+                           path const&,
+                           unsigned precision,
+                           bool with_stats);
+
+// The binary format carries no search statistics.
+std::string write_binary(ways const&, path const&);
+
+std::string write_route(ways const&,
+                        path const&,
+                        route_format,
+                        unsigned polyline_precision,
+                        bool with_stats);
+
+}  // namespace osr::backend
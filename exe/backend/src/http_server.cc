@@ -1,6 +1,15 @@
 #include "osr/backend/http_server.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
 #include <utility>
+#include <variant>
 
 #include "boost/algorithm/string.hpp"
 #include "boost/asio/post.hpp"
@@ -10,21 +19,30 @@
 #include "fmt/core.h"
 
 #include "utl/enumerate.h"
+#include "utl/helpers/algorithm.h"
 #include "utl/pipes.h"
 #include "utl/to_vec.h"
+#include "utl/verify.h"
+#include "utl/zip.h"
 
 #include "net/web_server/responses.h"
 #include "net/web_server/serve_static.h"
 #include "net/web_server/web_server.h"
 
+#include "osr/backend/metrics.h"
+#include "osr/backend/request_log.h"
+#include "osr/backend/response_cache.h"
+#include "osr/backend/route_response.h"
 #include "osr/geojson.h"
 #include "osr/lookup.h"
+#include "osr/routing/cancel_token.h"
 #include "osr/routing/profiles/bike.h"
 #include "osr/routing/profiles/bike_sharing.h"
 #include "osr/routing/profiles/car.h"
 #include "osr/routing/profiles/car_parking.h"
 #include "osr/routing/profiles/foot.h"
 #include "osr/routing/route.h"
+#include "osr/util/encoded_polyline.h"
 
 using namespace net;
 using net::web_server;
@@ -46,6 +64,15 @@ void set_cors_headers(http::response<Body>& res) {
   res.set(field::access_control_max_age, "3600");
 }
 
+web_server::string_res_t route_response(web_server::http_req_t const& req,
+                                        std::string const& content,
+                                        route_format const format) {
+  auto res = net::string_response(req, content, http::status::ok,
+                                  get_content_type(format));
+  set_cors_headers(res);
+  return res;
+}
+
 web_server::string_res_t json_response(
     web_server::http_req_t const& req,
     std::string const& content,
@@ -70,19 +97,56 @@ json::value to_json(std::vector<geo::latlng> const& polyline) {
   return a;
 }
 
+struct route_query {
+  location from_, to_;
+  search_profile profile_;
+  direction dir_;
+  cost_t max_;
+};
+
+// Invalid request parameters, answered with HTTP 400.
+struct bad_request : public std::runtime_error {
+  using std::runtime_error::runtime_error;
+};
+
+struct endpoint_limit {
+  unsigned max_{0U};  // 0 = unlimited
+  std::atomic_uint32_t in_flight_{0U};
+};
+
+struct route_batch {
+  std::vector<route_query> queries_;
+  std::vector<std::vector<std::size_t>> groups_;  // query indices
+  std::vector<std::optional<std::string>> results_;
+  std::atomic_size_t next_group_{0U};
+  std::atomic_size_t pending_tasks_{0U};
+  std::atomic_bool cancelled_{false};
+};
+
 struct http_server::impl {
   impl(boost::asio::io_context& ios,
        boost::asio::io_context& thread_pool,
        ways const& g,
        lookup const& l,
        platforms const* pl,
-       std::string const& static_file_path)
+       std::string const& static_file_path,
+       server_config const& config)
       : ioc_{ios},
         thread_pool_{thread_pool},
         w_{g},
         l_{l},
         pl_{pl},
-        server_{ioc_} {
+        server_{ioc_},
+        config_{config},
+        route_cache_{config.route_cache_bytes_, config.cache_shards_},
+        request_log_{config.request_log_.empty()
+                         ? nullptr
+                         : std::make_unique<request_log>(config.request_log_)} {
+    get_limit(api_endpoint::kRoute).max_ = config.max_concurrent_route_;
+    get_limit(api_endpoint::kRouteBatch).max_ =
+        config.max_concurrent_route_batch_;
+    get_limit(api_endpoint::kGraph).max_ = config.max_concurrent_graph_;
+    route_cache_.set_version(get_dataset_version(w_.p_));
     try {
       if (!static_file_path.empty() && fs::is_directory(static_file_path)) {
         static_file_path_ = fs::canonical(static_file_path).string();
@@ -101,48 +165,216 @@ struct http_server::impl {
                : to_profile(profile_it->value().as_string());
   }
 
-  void handle_route(web_server::http_req_t const& req,
-                    web_server::http_res_cb_t const& cb) {
-    auto const q = boost::json::parse(req.body()).as_object();
-    auto const profile = get_search_profile_from_request(q);
+  static route_query parse_route_query(boost::json::object const& q) {
     auto const direction_it = q.find("direction");
-    auto const dir = to_direction(direction_it == q.end() ||
-                                          !direction_it->value().is_string()
-                                      ? to_str(direction::kForward)
-                                      : direction_it->value().as_string());
-    auto const from = parse_location(q.at("start"));
-    auto const to = parse_location(q.at("destination"));
     auto const max_it = q.find("max");
-    auto const max = static_cast<cost_t>(
-        max_it == q.end() ? 3600 : max_it->value().as_int64());
-    auto const p = route(w_, l_, profile, from, to, max, dir, 100);
+    return {
+        .from_ = parse_location(q.at("start")),
+        .to_ = parse_location(q.at("destination")),
+        .profile_ = get_search_profile_from_request(q),
+        .dir_ = to_direction(direction_it == q.end() ||
+                                     !direction_it->value().is_string()
+                                 ? to_str(direction::kForward)
+                                 : direction_it->value().as_string()),
+        .max_ = static_cast<cost_t>(
+            max_it == q.end() ? 3600 : max_it->value().as_int64())};
+  }
+
+  static route_format get_route_format_from_request(
+      boost::json::object const& q) {
+    auto const format_it = q.find("format");
+    return format_it == q.end() || !format_it->value().is_string()
+               ? route_format::kGeoJson
+               : to_route_format(format_it->value().as_string());
+  }
+
+  static bool get_with_stats_from_request(boost::json::object const& q) {
+    auto const stats_it = q.find("stats");
+    return stats_it != q.end() && stats_it->value().is_bool() &&
+           stats_it->value().as_bool();
+  }
+
+  static unsigned get_polyline_precision_from_request(
+      boost::json::object const& q) {
+    auto const precision_it = q.find("precision");
+    if (precision_it == q.end()) {
+      return 5U;
+    }
+    auto const& v = precision_it->value();
+    if (!v.is_int64() || !is_valid_polyline_precision(v.as_int64())) {
+      throw bad_request{"precision has to be 5 or 6"};
+    }
+    return static_cast<unsigned>(v.as_int64());
+  }
+
+  void handle_route(web_server::http_req_t const& req,
+                    web_server::http_res_cb_t const& cb,
+                    std::shared_ptr<cancel_token> const& token) {
+    auto const q = boost::json::parse(req.body()).as_object();
+    auto const query = parse_route_query(q);
+    auto const format = get_route_format_from_request(q);
+    auto const precision = get_polyline_precision_from_request(q);
+    auto const with_stats = get_with_stats_from_request(q);
+    auto key = fmt::format(
+        "{}|{}|{}|{}|{}|{}|{},{},{}|{},{},{}", route_cache_.version(),
+        to_str(query.profile_), to_str(query.dir_), query.max_,
+        static_cast<int>(format), precision, quantize(query.from_.pos_.lat_),
+        quantize(query.from_.pos_.lng_), query.from_.lvl_.to_float(),
+        quantize(query.to_.pos_.lat_), quantize(query.to_.pos_.lng_),
+        query.to_.lvl_.to_float());
+    if (auto const cached = with_stats ? nullptr : route_cache_.get(key);
+        cached != nullptr) {
+      cb(route_response(req, *cached, format));
+      return;
+    }
+
+    auto const p = route(w_, l_, query.profile_, query.from_, query.to_,
+                         query.max_, query.dir_, 100, nullptr, nullptr,
+                         token.get());
     if (!p.has_value()) {
       cb(json_response(req, "could not find a valid path",
                        http::status::not_found));
       return;
     }
-    cb(json_response(
-        req,
-        json::serialize(json::object{
-            {"type", "FeatureCollection"},
-            {"metadata", {{"duration", p->cost_}, {"distance", p->dist_}}},
-            {"features", utl::all(p->segments_) |
-                             utl::transform([&](const path::segment& s) {
-                               return json::object{
-                                   {"type", "Feature"},
-                                   {
-                                       "properties",
-                                       {{"level", s.from_level_.to_float()},
-                                        {"osm_way_id",
-                                         s.way_ == way_idx_t::invalid()
-                                             ? 0U
-                                             : to_idx(w_.way_osm_idx_[s.way_])},
-                                        {"cost", s.cost_},
-                                        {"distance", s.dist_}},
-                                   },
-                                   {"geometry", to_line_string(s.polyline_)}};
-                             }) |
-                             utl::emplace_back_to<json::array>()}})));
+    metrics_.record_search(api_endpoint::kRoute, query.profile_, p->stats_);
+
+    auto const serialize_start = search_clock::now();
+    auto body = write_route(w_, *p, format, precision, with_stats);
+    metrics_.record(api_endpoint::kRoute, query.profile_,
+                    request_phase::kSerialize, elapsed_since(serialize_start));
+
+    cb(route_response(req, body, format));
+    if (!with_stats) {  // statistics differ between runs
+      route_cache_.put(std::move(key), std::move(body));
+    }
+  }
+
+  // Queries with the same origin, profile and direction share one
+  // one-to-many search. Up to max_batch_threads_ thread pool tasks take
+  // groups until none are left; they count as queued requests. The task
+  // finishing last sends the response (HTTP 503 if the deadline expired).
+  void handle_route_batch(web_server::http_req_t const& req,
+                          web_server::http_res_cb_t const& cb,
+                          std::shared_ptr<cancel_token> const& token) {
+    auto const q = boost::json::parse(req.body()).as_object();
+    auto const format = get_route_format_from_request(q);
+    auto const precision = get_polyline_precision_from_request(q);
+    auto const with_stats = get_with_stats_from_request(q);
+    if (format == route_format::kBinary) {
+      throw bad_request{"binary format not supported for batch requests"};
+    }
+
+    auto const& queries = q.at("queries").as_array();
+    auto batch = std::make_shared<route_batch>();
+    batch->queries_ = utl::to_vec(queries, [](json::value const& x) {
+      return parse_route_query(x.as_object());
+    });
+    batch->results_.resize(batch->queries_.size());
+
+    using group_key_t =
+        std::tuple<double, double, float, search_profile, direction>;
+    auto groups = std::map<group_key_t, std::vector<std::size_t>>{};
+    for (auto const [i, x] : utl::enumerate(batch->queries_)) {
+      groups[{x.from_.pos_.lat_, x.from_.pos_.lng_, x.from_.lvl_.to_float(),
+              x.profile_, x.dir_}]
+          .push_back(i);
+    }
+    batch->groups_ = utl::to_vec(groups, [](auto& g) {
+      return std::move(g.second);
+    });
+
+    auto const finish = [req, cb, batch]() {
+      if (batch->cancelled_) {
+        return cb(json_response(req,
+                                R"({"error": "request deadline exceeded"})",
+                                http::status::service_unavailable));
+      }
+      auto res = std::string{"["};
+      for (auto const [i, r] : utl::enumerate(batch->results_)) {
+        if (i != 0U) {
+          res.push_back(',');
+        }
+        res.append(r.has_value() ? *r : "null");
+      }
+      res.push_back(']');
+      cb(json_response(req, res));
+    };
+
+    if (batch->groups_.empty()) {
+      finish();
+      return;
+    }
+
+    auto const n_tasks =
+        config_.max_batch_threads_ == 0U
+            ? batch->groups_.size()
+            : std::min(batch->groups_.size(),
+                       std::size_t{config_.max_batch_threads_});
+    if (config_.max_queued_requests_ != 0U &&
+        queued_.load() + n_tasks > config_.max_queued_requests_) {
+      metrics_.count_rejected(api_endpoint::kRouteBatch);
+      return cb(json_response(req, R"({"error": "server overloaded"})",
+                              http::status::service_unavailable));
+    }
+
+    auto const task = [this, batch, finish, format, precision, with_stats,
+                       token]() {
+      --queued_;
+      for (auto g = batch->next_group_++;
+           g < batch->groups_.size() && !batch->cancelled_;
+           g = batch->next_group_++) {
+        auto const& group = batch->groups_[g];
+        auto const& first = batch->queries_[group.front()];
+        try {
+          if (token->is_cancelled()) {
+            throw search_cancelled{};
+          }
+          auto const max = utl::max_element(group, [&](auto&& a, auto&& b) {
+            return batch->queries_[a].max_ < batch->queries_[b].max_;
+          });
+          auto const paths = route(
+              w_, l_, first.profile_, first.from_,
+              utl::to_vec(group,
+                          [&](std::size_t const i) {
+                            return batch->queries_[i].to_;
+                          }),
+              batch->queries_[*max].max_, first.dir_, 100, nullptr, nullptr,
+              [](path const&) { return true; }, token.get());
+          auto const found = utl::find_if(
+              paths, [](auto const& p) { return p.has_value(); });
+          if (found != end(paths)) {
+            metrics_.record_search(api_endpoint::kRouteBatch, first.profile_,
+                                   (*found)->stats_);
+          }
+
+          auto const serialize_start = search_clock::now();
+          for (auto const [i, p] : utl::zip(group, paths)) {
+            if (p.has_value() && p->cost_ < batch->queries_[i].max_) {
+              batch->results_[i] =
+                  write_route(w_, *p, format, precision, with_stats);
+            }
+          }
+          metrics_.record(api_endpoint::kRouteBatch, first.profile_,
+                          request_phase::kSerialize,
+                          elapsed_since(serialize_start));
+        } catch (search_cancelled const&) {
+          batch->cancelled_ = true;
+        } catch (std::exception const& e) {
+          for (auto const i : group) {
+            batch->results_[i] = fmt::format(R"({{"error": "{}"}})", e.what());
+          }
+        }
+      }
+      if (--batch->pending_tasks_ == 0U) {
+        finish();
+      }
+    };
+
+    batch->pending_tasks_ = n_tasks;
+    queued_ += n_tasks;
+    for (auto i = std::size_t{0U}; i != n_tasks; ++i) {
+      boost::asio::post(thread_pool_, task);
+    }
   }
 
   void handle_levels(web_server::http_req_t const& req,
@@ -179,39 +411,65 @@ struct http_server::impl {
     auto const max =
         geo::latlng{waypoints[3].as_double(), waypoints[2].as_double()};
 
+    // Not cached: the node labels come from the last search of this thread.
     auto gj = geojson_writer{.w_ = w_};
     l_.find({min, max}, [&](way_idx_t const w) { gj.write_way(w); });
 
     switch (profile) {
       case search_profile::kFoot:
-        send_graph_response<foot<false, elevator_tracking>>(req, cb, gj);
+        gj.finish(&get_dijkstra<foot<false, elevator_tracking>>());
         break;
       case search_profile::kWheelchair:
-        send_graph_response<foot<true, elevator_tracking>>(req, cb, gj);
+        gj.finish(&get_dijkstra<foot<true, elevator_tracking>>());
         break;
-      case search_profile::kBike: send_graph_response<bike>(req, cb, gj); break;
-      case search_profile::kCar: send_graph_response<car>(req, cb, gj); break;
+      case search_profile::kBike: gj.finish(&get_dijkstra<bike>()); break;
+      case search_profile::kCar: gj.finish(&get_dijkstra<car>()); break;
       case search_profile::kCarParking:
-        send_graph_response<car_parking<false>>(req, cb, gj);
+        gj.finish(&get_dijkstra<car_parking<false>>());
         break;
       case search_profile::kCarParkingWheelchair:
-        send_graph_response<car_parking<true>>(req, cb, gj);
+        gj.finish(&get_dijkstra<car_parking<true>>());
         break;
       case search_profile::kBikeSharing:
-        send_graph_response<bike_sharing>(req, cb, gj);
+        gj.finish(&get_dijkstra<bike_sharing>());
         break;
       default: throw utl::fail("not implemented");
     }
-  }
 
-  template <typename Profile>
-  void send_graph_response(web_server::http_req_t const& req,
-                           web_server::http_res_cb_t const& cb,
-                           geojson_writer& gj) {
-    gj.finish(&get_dijkstra<Profile>());
     cb(json_response(req, gj.string()));
   }
 
+  std::string get_cache_stats() const {
+    auto const to_json = [](response_cache::stats const& st) {
+      return json::object{{"hits", st.hits_},
+                          {"misses", st.misses_},
+                          {"evictions", st.evictions_},
+                          {"entries", st.entries_},
+                          {"bytes", st.bytes_}};
+    };
+    return json::serialize(
+        json::object{{"route", to_json(route_cache_.get_stats())}});
+  }
+
+  std::string get_metrics() const {
+    auto out = metrics_.to_prometheus();
+    auto it = std::back_inserter(out);
+    out.append(
+        "# HELP osr_cache_hits_total Response cache hits.\n"
+        "# TYPE osr_cache_hits_total counter\n"
+        "# HELP osr_cache_misses_total Response cache misses.\n"
+        "# TYPE osr_cache_misses_total counter\n"
+        "# HELP osr_cache_bytes Bytes held by the response cache.\n"
+        "# TYPE osr_cache_bytes gauge\n");
+    auto const st = route_cache_.get_stats();
+    fmt::format_to(it,
+                   "osr_cache_hits_total{{cache=\"route\"}} {}\n"
+                   "osr_cache_misses_total{{cache=\"route\"}} {}\n"
+                   "osr_cache_bytes{{cache=\"route\"}} {}\n",
+                   st.hits_, st.misses_, st.bytes_);
+    return out;
+  }
+
   void handle_static(web_server::http_req_t const& req,
                      web_server::http_res_cb_t const& cb) {
     if (auto res = net::serve_static_file(static_file_path_, req);
@@ -254,40 +512,63 @@ struct http_server::impl {
       case http::verb::options: return cb(json_response(req, {}));
       case http::verb::post: {
         auto const& target = req.target();
-        if (target.starts_with("/api/route")) {
+        if (request_log_ != nullptr && target.starts_with("/api/")) {
+          request_log_->write({target.data(), target.size()}, req.body());
+        }
+        if (target.starts_with("/api/route/batch")) {
           return run_parallel(
               [this](web_server::http_req_t const& req1,
-                     web_server::http_res_cb_t const& cb1) {
-                handle_route(req1, cb1);
+                     web_server::http_res_cb_t const& cb1,
+                     std::shared_ptr<cancel_token> const& token) {
+                handle_route_batch(req1, cb1, token);
               },
-              req, cb);
+              req, cb, api_endpoint::kRouteBatch);
+        } else if (target.starts_with("/api/route")) {
+          return run_parallel(
+              [this](web_server::http_req_t const& req1,
+                     web_server::http_res_cb_t const& cb1,
+                     std::shared_ptr<cancel_token> const& token) {
+                handle_route(req1, cb1, token);
+              },
+              req, cb, api_endpoint::kRoute);
         } else if (target.starts_with("/api/levels")) {
           return run_parallel(
               [this](web_server::http_req_t const& req1,
-                     web_server::http_res_cb_t const& cb1) {
+                     web_server::http_res_cb_t const& cb1,
+                     std::shared_ptr<cancel_token> const&) {
                 handle_levels(req1, cb1);
               },
-              req, cb);
+              req, cb, api_endpoint::kLevels);
         } else if (target.starts_with("/api/graph")) {
           return run_parallel(
               [this](web_server::http_req_t const& req1,
-                     web_server::http_res_cb_t const& cb1) {
+                     web_server::http_res_cb_t const& cb1,
+                     std::shared_ptr<cancel_token> const&) {
                 handle_graph(req1, cb1);
               },
-              req, cb);
+              req, cb, api_endpoint::kGraph);
         } else if (target.starts_with("/api/platforms")) {
           return run_parallel(
               [this](web_server::http_req_t const& req1,
-                     web_server::http_res_cb_t const& cb1) {
+                     web_server::http_res_cb_t const& cb1,
+                     std::shared_ptr<cancel_token> const&) {
                 handle_platforms(req1, cb1);
               },
-              req, cb);
+              req, cb, api_endpoint::kPlatforms);
         } else {
           return cb(json_response(req, R"({"error": "Not found"})",
                                   http::status::not_found));
         }
       }
       case http::verb::get:
+        if (req.target() == "/api/cache") {
+          return cb(json_response(req, get_cache_stats()));
+        } else if (req.target() == "/metrics") {
+          auto res = net::string_response(req, get_metrics(), http::status::ok,
+                                          "text/plain; version=0.0.4");
+          return cb(std::move(res));
+        }
+        return handle_static(req, cb);
       case http::verb::head: return handle_static(req, cb);
       default:
         return cb(json_response(req,
@@ -296,31 +577,93 @@ struct http_server::impl {
     }
   }
 
+  // Rejects the request if the queue or the endpoint is full. Otherwise,
+  // the handler runs on the thread pool with a token that expires at the
+  // request deadline. The endpoint slot is released with the response.
   template <typename Fn>
   void run_parallel(
       Fn&& handler,  // NOLINT(cppcoreguidelines-missing-std-forward)
       web_server::http_req_t const& req,
-      web_server::http_res_cb_t const& cb) {
-    boost::asio::post(
-        thread_pool_, [req, cb, h = std::forward<Fn>(handler), this]() {
-          try {
-            h(req, [req, cb, this](web_server::http_res_t&& res) {
-              boost::asio::post(ioc_, [cb, req, res{std::move(res)}]() mutable {
-                try {
-                  cb(std::move(res));
-                } catch (std::exception const& e) {
-                  return cb(json_response(
-                      req, fmt::format(R"({{"error": "{}"}})", e.what()),
-                      http::status::internal_server_error));
-                }
-              });
-            });
-          } catch (std::exception const& e) {
-            return cb(json_response(
-                req, fmt::format(R"({{"error": "{}"}})", e.what()),
-                http::status::internal_server_error));
-          }
-        });
+      web_server::http_res_cb_t const& cb,
+      api_endpoint const endpoint) {
+    auto& limit = get_limit(endpoint);
+    if (config_.max_queued_requests_ != 0U &&
+        queued_.load() >= config_.max_queued_requests_) {
+      metrics_.count_rejected(endpoint);
+      return cb(json_response(req, R"({"error": "server overloaded"})",
+                              http::status::service_unavailable));
+    }
+    if (auto const in_flight = limit.in_flight_.fetch_add(1U);
+        limit.max_ != 0U && in_flight >= limit.max_) {
+      --limit.in_flight_;
+      metrics_.count_rejected(endpoint);
+      return cb(json_response(req, R"({"error": "server overloaded"})",
+                              http::status::service_unavailable));
+    }
+
+    auto const slot = std::shared_ptr<endpoint_limit>{
+        &limit, [](endpoint_limit* l) { --l->in_flight_; }};
+    auto const token = std::make_shared<cancel_token>(
+        config_.request_timeout_.count() == 0
+            ? cancel_token::clock::time_point::max()
+            : cancel_token::clock::now() + config_.request_timeout_);
+    auto const admitted = search_clock::now();
+
+    // Sends the response and records its status and the total time.
+    auto const respond = [cb, endpoint, admitted,
+                          this](web_server::http_res_t&& res) {
+      metrics_.count_response(
+          endpoint, std::visit([](auto const& r) { return r.result_int(); },
+                               res));
+      metrics_.record(endpoint, std::nullopt, request_phase::kTotal,
+                      elapsed_since(admitted));
+      cb(std::move(res));
+    };
+
+    ++queued_;
+    boost::asio::post(thread_pool_, [req, respond, slot, token, admitted,
+                                     endpoint, this,
+                                     h = std::forward<Fn>(handler)]() {
+      --queued_;
+      metrics_.record(endpoint, std::nullopt, request_phase::kQueueWait,
+                      elapsed_since(admitted));
+      try {
+        if (token->is_cancelled()) {
+          throw search_cancelled{};
+        }
+        h(
+            req,
+            [req, respond, slot, this](web_server::http_res_t&& res) {
+              boost::asio::post(
+                  ioc_, [respond, req, res{std::move(res)}]() mutable {
+                    try {
+                      respond(std::move(res));
+                    } catch (std::exception const& e) {
+                      return respond(json_response(
+                          req, fmt::format(R"({{"error": "{}"}})", e.what()),
+                          http::status::internal_server_error));
+                    }
+                  });
+            },
+            token);
+      } catch (search_cancelled const&) {
+        return respond(json_response(
+            req, R"({"error": "request deadline exceeded"})",
+            http::status::service_unavailable));
+      } catch (bad_request const& e) {
+        return respond(json_response(
+            req, fmt::format(R"({{"error": "{}"}})", e.what()),
+            http::status::bad_request));
+      } catch (std::exception const& e) {
+        return respond(json_response(
+            req, fmt::format(R"({{"error": "{}"}})", e.what()),
+            http::status::internal_server_error));
+      }
+    });
+  }
+
+  endpoint_limit& get_limit(api_endpoint const e) {
+    return limits_[static_cast<unsigned>(e)];
   }
 
   void listen(std::string const& host, std::string const& port) {
@@ -344,7 +687,12 @@ struct http_server::impl {
     server_.run();
   }
 
-  void stop() { server_.stop(); }
+  void stop() {
+    server_.stop();
+    if (request_log_ != nullptr) {
+      request_log_->flush();
+    }
+  }
 
 private:
   boost::asio::io_context& ioc_;
@@ -353,6 +701,12 @@ private:
   lookup const& l_;
   platforms const* pl_;
   web_server server_;
+  server_config config_;
+  std::atomic_size_t queued_{0U};
+  std::array<endpoint_limit, kNEndpoints> limits_;
+  metrics metrics_;
+  response_cache route_cache_;
+  std::unique_ptr<request_log> request_log_;
   bool serve_static_files_{false};
   std::string static_file_path_;
 };
@@ -362,8 +716,9 @@ http_server::http_server(boost::asio::io_context& ioc,
                          ways const& w,
                          lookup const& l,
                          platforms const* pl,
-                         std::string const& static_file_path)
-    : impl_(new impl(ioc, thread_pool, w, l, pl, static_file_path)) {}
+                         std::string const& static_file_path,
+                         server_config const& config)
+    : impl_(new impl(ioc, thread_pool, w, l, pl, static_file_path, config)) {}
 
 http_server::~http_server() = default;
 
@@ -30,6 +30,19 @@ public:
     param(static_file_path_, "static,s", "Path to static files (ui/web)");
     param(threads_, "threads,t", "Number of routing threads");
     param(lock_, "lock,l", "Lock to memory");
+    param(route_cache_mb_, "route_cache_mb", "Route response cache size (MB)");
+    param(max_queued_, "max_queued", "Max. queued requests (0 = unlimited)");
+    param(max_concurrent_route_, "max_concurrent_route",
+          "Max. concurrent /api/route requests (0 = unlimited)");
+    param(max_concurrent_route_batch_, "max_concurrent_route_batch",
+          "Max. concurrent /api/route/batch requests (0 = unlimited)");
+    param(max_concurrent_graph_, "max_concurrent_graph",
+          "Max. concurrent /api/graph requests (0 = unlimited)");
+    param(max_batch_threads_, "max_batch_threads",
+          "Max. threads per /api/route/batch request (0 = unlimited)");
+    param(timeout_ms_, "timeout_ms", "Request deadline in ms (0 = none)");
+    param(request_log_, "request_log",
+          "Append API requests to this file (for osr-replay)");
   }
 
   fs::path data_dir_{"osr"};
@@ -38,6 +51,14 @@ public:
   std::string static_file_path_;
   bool lock_{true};
   unsigned threads_{std::thread::hardware_concurrency()};
+  std::size_t route_cache_mb_{64U};
+  std::size_t max_queued_{1024U};
+  unsigned max_concurrent_route_{0U};
+  unsigned max_concurrent_route_batch_{0U};
+  unsigned max_concurrent_graph_{0U};
+  unsigned max_batch_threads_{4U};
+  unsigned timeout_ms_{30000U};
+  fs::path request_log_;
 };
 
 auto run(boost::asio::io_context& ioc) {
@@ -94,7 +115,17 @@ int main(int argc, char const* argv[]) {
 
   auto ioc = boost::asio::io_context{};
   auto pool = boost::asio::io_context{};
-  auto server = http_server{ioc, pool, w, l, pl.get(), opt.static_file_path_};
+  auto const config = server_config{
+      .route_cache_bytes_ = opt.route_cache_mb_ * 1024U * 1024U,
+      .max_queued_requests_ = opt.max_queued_,
+      .max_concurrent_route_ = opt.max_concurrent_route_,
+      .max_concurrent_route_batch_ = opt.max_concurrent_route_batch_,
+      .max_concurrent_graph_ = opt.max_concurrent_graph_,
+      .max_batch_threads_ = opt.max_batch_threads_,
+      .request_timeout_ = std::chrono::milliseconds{opt.timeout_ms_},
+      .request_log_ = opt.request_log_};
+  auto server = http_server{ioc, pool, w, l, pl.get(), opt.static_file_path_,
+                            config};
 
   auto work_guard = boost::asio::make_work_guard(pool);
   auto threads = std::vector<std::thread>(std::max(1U, opt.threads_));
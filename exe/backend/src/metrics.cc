@@ -0,0 +1,267 @@
+#include "osr/backend/metrics.h"
+
+#include <algorithm>
+#include <array>
+#include <iterator>
+#include <utility>
+
+#include "fmt/format.h"
+
+namespace osr::backend {
+
+namespace {
+
+// All search profiles + "none" for requests without profile.
+constexpr auto const kNProfiles =
+    static_cast<unsigned>(search_profile::kBikeSharing) + 2U;
+constexpr auto const kNoProfile = kNProfiles - 1U;
+
+constexpr auto const kNStatusClasses = 5U;  // 1xx - 5xx
+
+constexpr auto const kLeSeconds = std::array{
+    0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025,
+    0.05,   0.1,     0.25,   0.5,   1.0,    2.5,   5.0,  10.0, 30.0};
+
+std::atomic_uint64_t next_id{0U};
+
+unsigned profile_idx(std::optional<search_profile> const p) {
+  return p.has_value() ? static_cast<unsigned>(*p) : kNoProfile;
+}
+
+std::string_view profile_str(unsigned const i) {
+  return i == kNoProfile ? "none" : to_str(static_cast<search_profile>(i));
+}
+
+void add(std::atomic_uint64_t& x, std::uint64_t const v) {
+  x.fetch_add(v, std::memory_order_relaxed);
+}
+
+void add(std::atomic_uint32_t& x, std::uint32_t const v) {
+  x.fetch_add(v, std::memory_order_relaxed);
+}
+
+std::uint64_t get(std::atomic_uint64_t const& x) {
+  return x.load(std::memory_order_relaxed);
+}
+
+std::uint64_t get(std::atomic_uint32_t const& x) {
+  return x.load(std::memory_order_relaxed);
+}
+
+}  // namespace
+
+std::string_view to_str(api_endpoint const e) {
+  switch (e) {
+    case api_endpoint::kRoute: return "route";
+    case api_endpoint::kRouteBatch: return "route_batch";
+    case api_endpoint::kLevels: return "levels";
+    case api_endpoint::kGraph: return "graph";
+    case api_endpoint::kPlatforms: return "platforms";
+  }
+  std::unreachable();
+}
+
+std::string_view to_str(request_phase const p) {
+  switch (p) {
+    case request_phase::kQueueWait: return "queue_wait";
+    case request_phase::kMatch: return "match";
+    case request_phase::kSearch: return "search";
+    case request_phase::kReconstruct: return "reconstruct";
+    case request_phase::kSerialize: return "serialize";
+    case request_phase::kTotal: return "total";
+  }
+  std::unreachable();
+}
+
+struct histogram {
+  std::array<std::atomic_uint32_t, histogram_layout::kNBuckets> buckets_{};
+  std::atomic_uint64_t count_{0U};
+  std::atomic_uint64_t sum_us_{0U};
+};
+
+struct metrics::shard {
+  histogram& get(api_endpoint const e,
+                 unsigned const profile,
+                 request_phase const p) {
+    return histograms_[(static_cast<unsigned>(e) * kNProfiles + profile) *
+                           kNPhases +
+                       static_cast<unsigned>(p)];
+  }
+
+  std::array<histogram, kNEndpoints * kNProfiles * kNPhases> histograms_{};
+  std::array<std::atomic_uint64_t, kNEndpoints * kNStatusClasses> responses_{};
+  std::array<std::atomic_uint64_t, kNEndpoints> rejected_{};
+  std::array<std::atomic_uint64_t, kNProfiles> searches_{};
+  std::array<std::atomic_uint64_t, kNProfiles> settled_{};
+  std::array<std::atomic_uint64_t, kNProfiles> pushed_{};
+};
+
+metrics::metrics() : id_{++next_id} {}
+
+metrics::~metrics() = default;
+
+metrics::shard& metrics::local() {
+  thread_local auto cache = std::pair<std::uint64_t, shard*>{0U, nullptr};
+  if (cache.first != id_) {
+    auto const l = std::scoped_lock{mutex_};
+    cache = {id_, shards_.emplace_back(std::make_unique<shard>()).get()};
+  }
+  return *cache.second;
+}
+
+void metrics::record(api_endpoint const e,
+                     std::optional<search_profile> const profile,
+                     request_phase const p,
+                     search_stats::duration_t const duration) {
+  auto const us = duration.count() < 0
+                      ? std::uint64_t{0U}
+                      : static_cast<std::uint64_t>(to_us(duration));
+  auto& h = local().get(e, profile_idx(profile), p);
+  add(h.buckets_[histogram_layout::get_bucket(us)], 1U);
+  add(h.count_, 1U);
+  add(h.sum_us_, us);
+}
+
+void metrics::record_search(api_endpoint const e,
+                            search_profile const profile,
+                            search_stats const& stats) {
+  auto& s = local();
+  auto const i = profile_idx(profile);
+  add(s.searches_[i], 1U);
+  add(s.settled_[i], stats.n_settled_);
+  add(s.pushed_[i], stats.n_pushed_);
+  record(e, profile, request_phase::kMatch, stats.match_time_);
+  record(e, profile, request_phase::kSearch, stats.search_time_);
+  record(e, profile, request_phase::kReconstruct, stats.reconstruct_time_);
+}
+
+void metrics::count_response(api_endpoint const e, unsigned const status) {
+  auto const status_class = std::clamp(status / 100U, 1U, 5U) - 1U;
+  add(local().responses_[static_cast<unsigned>(e) * kNStatusClasses +
+                         status_class],
+      1U);
+}
+
+void metrics::count_rejected(api_endpoint const e) {
+  add(local().rejected_[static_cast<unsigned>(e)], 1U);
+}
+
+std::string metrics::to_prometheus() const {
+  auto const l = std::scoped_lock{mutex_};
+  auto out = std::string{};
+  auto it = std::back_inserter(out);
+
+  auto const sum = [&](auto&& get_value) {
+    auto total = std::uint64_t{0U};
+    for (auto const& s : shards_) {
+      total += get(get_value(*s));
+    }
+    return total;
+  };
+
+  out.append(
+      "# HELP osr_responses_total Responses by endpoint and status class.\n"
+      "# TYPE osr_responses_total counter\n");
+  for (auto e = 0U; e != kNEndpoints; ++e) {
+    for (auto c = 0U; c != kNStatusClasses; ++c) {
+      auto const n = sum([&](shard const& s) -> auto const& {
+        return s.responses_[e * kNStatusClasses + c];
+      });
+      if (n != 0U) {
+        fmt::format_to(it,
+                       "osr_responses_total{{endpoint=\"{}\",code=\"{}xx\"}} "
+                       "{}\n",
+                       to_str(static_cast<api_endpoint>(e)), c + 1U, n);
+      }
+    }
+  }
+
+  out.append(
+      "# HELP osr_rejected_total Requests rejected by admission control.\n"
+      "# TYPE osr_rejected_total counter\n");
+  for (auto e = 0U; e != kNEndpoints; ++e) {
+    fmt::format_to(
+        it, "osr_rejected_total{{endpoint=\"{}\"}} {}\n",
+        to_str(static_cast<api_endpoint>(e)),
+        sum([&](shard const& s) -> auto const& { return s.rejected_[e]; }));
+  }
+
+  auto const write_profile_counter = [&](std::string_view name,
+                                         std::string_view help,
+                                         auto&& get_value) {
+    fmt::format_to(it, "# HELP {} {}\n# TYPE {} counter\n", name, help, name);
+    for (auto p = 0U; p != kNoProfile; ++p) {
+      fmt::format_to(
+          it, "{}{{profile=\"{}\"}} {}\n", name, profile_str(p),
+          sum([&](shard const& s) -> auto const& { return get_value(s)[p]; }));
+    }
+  };
+  write_profile_counter("osr_searches_total", "Searches run.",
+                        [](shard const& s) -> auto const& {
+                          return s.searches_;
+                        });
+  write_profile_counter("osr_settled_labels_total", "Labels settled.",
+                        [](shard const& s) -> auto const& {
+                          return s.settled_;
+                        });
+  write_profile_counter("osr_pushed_labels_total", "Labels pushed.",
+                        [](shard const& s) -> auto const& {
+                          return s.pushed_;
+                        });
+
+  out.append(
+      "# HELP osr_request_duration_seconds Time spent per request phase.\n"
+      "# TYPE osr_request_duration_seconds histogram\n");
+  auto buckets = std::array<std::uint64_t, histogram_layout::kNBuckets>{};
+  for (auto e = 0U; e != kNEndpoints; ++e) {
+    for (auto p = 0U; p != kNProfiles; ++p) {
+      for (auto ph = 0U; ph != kNPhases; ++ph) {
+        auto const endpoint = static_cast<api_endpoint>(e);
+        auto const phase = static_cast<request_phase>(ph);
+
+        auto count = std::uint64_t{0U};
+        auto sum_us = std::uint64_t{0U};
+        buckets.fill(0U);
+        for (auto const& s : shards_) {
+          auto& h = s->get(endpoint, p, phase);
+          count += get(h.count_);
+          sum_us += get(h.sum_us_);
+          for (auto i = 0U; i != histogram_layout::kNBuckets; ++i) {
+            buckets[i] += get(h.buckets_[i]);
+          }
+        }
+        if (count == 0U) {
+          continue;
+        }
+
+        auto const labels =
+            fmt::format(R"(endpoint="{}",profile="{}",phase="{}")",
+                        to_str(endpoint), profile_str(p), to_str(phase));
+        auto cumulative = std::uint64_t{0U};
+        auto i = 0U;
+        for (auto const le : kLeSeconds) {
+          auto const le_us = static_cast<std::uint64_t>(le * 1E6);
+          while (i != histogram_layout::kNBuckets &&
+                 histogram_layout::get_upper_bound(i) <= le_us + 1U) {
+            cumulative += buckets[i++];
+          }
+          fmt::format_to(it,
+                         "osr_request_duration_seconds_bucket{{{},le=\"{}\"}} "
+                         "{}\n",
+                         labels, le, cumulative);
+        }
+        fmt::format_to(it,
+                       "osr_request_duration_seconds_bucket{{{},le=\"+Inf\"}} "
+                       "{}\n"
+                       "osr_request_duration_seconds_sum{{{}}} {}\n"
+                       "osr_request_duration_seconds_count{{{}}} {}\n",
+                       labels, count, labels,
+                       static_cast<double>(sum_us) / 1E6, labels, count);
+      }
+    }
+  }
+
+  return out;
+}
+
+}  // namespace osr::backend
@@ -0,0 +1,30 @@
+#include "osr/backend/request_log.h"
+
+#include "boost/json.hpp"
+
+#include "utl/verify.h"
+
+namespace osr::backend {
+
+request_log::request_log(std::filesystem::path const& p)
+    : out_{p, std::ios_base::app} {
+  utl::verify(out_.good(), "request log: could not open {}", p.string());
+}
+
+void request_log::write(std::string_view target, std::string_view body) {
+  auto const time = std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::system_clock::now().time_since_epoch())
+                        .count();
+  auto const line = boost::json::serialize(boost::json::object{
+      {"time_us", time}, {"target", target}, {"body", body}});
+
+  auto const l = std::scoped_lock{mutex_};
+  out_ << line << '\n';
+}
+
+void request_log::flush() {
+  auto const l = std::scoped_lock{mutex_};
+  out_.flush();
+}
+
+}  // namespace osr::backend
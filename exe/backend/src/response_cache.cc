@@ -0,0 +1,126 @@
+#include "osr/backend/response_cache.h"
+
+#include <chrono>
+#include <cmath>
+#include <list>
+#include <mutex>
+#include <utility>
+
+#include "cista/hash.h"
+
+#include "utl/verify.h"
+
+#include "osr/types.h"
+
+namespace osr::backend {
+
+struct response_cache::shard {
+  using list_t = std::list<std::pair<std::string, value_t>>;
+
+  std::mutex mutex_;
+  list_t lru_;  // most recently used first
+  hash_map<std::string_view, list_t::iterator> index_;
+  std::size_t bytes_{0U};
+};
+
+response_cache::response_cache(std::size_t const max_bytes,
+                               unsigned const n_shards)
+    : max_bytes_{max_bytes} {
+  utl::verify(n_shards != 0U, "response cache: at least one shard required");
+  shards_.resize(n_shards);
+  for (auto& s : shards_) {
+    s = std::make_unique<shard>();
+  }
+}
+
+response_cache::~response_cache() = default;
+
+response_cache::shard& response_cache::get_shard(std::string_view key) {
+  return *shards_[cista::hash(key) % shards_.size()];
+}
+
+response_cache::value_t response_cache::get(std::string const& key) {
+  if (!enabled()) {
+    return nullptr;
+  }
+
+  auto& s = get_shard(key);
+  auto const l = std::scoped_lock{s.mutex_};
+  auto const it = s.index_.find(std::string_view{key});
+  if (it == end(s.index_)) {
+    ++misses_;
+    return nullptr;
+  }
+  s.lru_.splice(begin(s.lru_), s.lru_, it->second);
+  ++hits_;
+  return it->second->second;
+}
+
+void response_cache::put(std::string key, std::string value) {
+  auto const size = key.size() + value.size();
+  auto const shard_budget = max_bytes_ / shards_.size();
+  if (!enabled() || size > shard_budget) {
+    return;
+  }
+
+  auto& s = get_shard(key);
+  auto const l = std::scoped_lock{s.mutex_};
+  if (s.index_.contains(std::string_view{key})) {
+    return;  // computed concurrently by another thread
+  }
+
+  s.lru_.emplace_front(std::move(key),
+                       std::make_shared<std::string const>(std::move(value)));
+  s.index_.emplace(std::string_view{s.lru_.front().first}, begin(s.lru_));
+  s.bytes_ += size;
+
+  while (s.bytes_ > shard_budget) {
+    auto const& [k, v] = s.lru_.back();
+    s.bytes_ -= k.size() + v->size();
+    s.index_.erase(std::string_view{k});
+    s.lru_.pop_back();
+    ++evictions_;
+  }
+}
+
+void response_cache::set_version(std::uint64_t const v) {
+  if (version_.exchange(v) != v) {
+    clear();
+  }
+}
+
+void response_cache::clear() {
+  for (auto& s : shards_) {
+    auto const l = std::scoped_lock{s->mutex_};
+    s->index_.clear();
+    s->lru_.clear();
+    s->bytes_ = 0U;
+  }
+}
+
+response_cache::stats response_cache::get_stats() const {
+  auto st = stats{.hits_ = hits_, .misses_ = misses_, .evictions_ = evictions_};
+  for (auto const& s : shards_) {
+    auto const l = std::scoped_lock{s->mutex_};
+    st.entries_ += s->lru_.size();
+    st.bytes_ += s->bytes_;
+  }
+  return st;
+}
+
+std::uint64_t get_dataset_version(std::filesystem::path const& data_dir) {
+  auto const routing = data_dir / "routing.bin";
+  auto const size = std::filesystem::file_size(routing);
+  auto const mtime = std::filesystem::last_write_time(routing)
+                         .time_since_epoch()
+                         .count();
+  return cista::hash_combine(cista::BASE_HASH, size,
+                             static_cast<std::uint64_t>(mtime));
+}
+
+std::int64_t quantize(double const coordinate) {
+  return static_cast<std::int64_t>(
+      std::round(coordinate * kCacheCoordinatePrecision));
+}
+
+}  // namespace osr::backend
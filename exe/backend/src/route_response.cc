@@ -0,0 +1,197 @@
+#include "osr/backend/route_response.h"
+
+#include <iterator>
+#include <utility>
+
+#include "boost/json.hpp"
+
+#include "cista/serialization.h"
+
+#include "fmt/format.h"
+
+#include "utl/pipes.h"
+#include "utl/verify.h"
+
+#include "osr/geojson.h"
+#include "osr/point.h"
+#include "osr/util/encoded_polyline.h"
+
+namespace osr::backend {
+
+route_format to_route_format(std::string_view s) {
+  switch (cista::hash(s)) {
+    case cista::hash("geojson"): return route_format::kGeoJson;
+    case cista::hash("geojson_stream"): return route_format::kGeoJsonStream;
+    case cista::hash("polyline"): return route_format::kPolyline;
+    case cista::hash("binary"): return route_format::kBinary;
+  }
+  throw utl::fail("{} is not a valid route format", s);
+}
+
+char const* get_content_type(route_format const f) {
+  return f == route_format::kBinary ? "application/octet-stream"
+                                    : "application/json";
+}
+
+std::uint64_t get_osm_way_id(ways const& w, path::segment const& s) {
+  return s.way_ == way_idx_t::invalid() ? 0U : to_idx(w.way_osm_idx_[s.way_]);
+}
+
+boost::json::object to_json(search_stats const& s) {
+  return {{"popped", s.n_popped_},
+          {"stale", s.n_stale_},
+          {"settled", s.n_settled_},
+          {"pushed", s.n_pushed_},
+          {"dominated", s.n_dominated_},
+          {"max_cutoff", s.n_max_cutoff_},
+          {"max_queue_size", s.max_queue_size_},
+          {"entries", s.n_entries_},
+          {"match_us", to_us(s.match_time_)},
+          {"search_us", to_us(s.search_time_)},
+          {"reconstruct_us", to_us(s.reconstruct_time_)}};
+}
+
+std::string write_geojson(ways const& w,
+                          path const& p,
+                          bool const with_stats) {
+  namespace json = boost::json;
+  auto metadata = json::object{{"duration", p.cost_}, {"distance", p.dist_}};
+  if (with_stats) {
+    metadata.emplace("stats", to_json(p.stats_));
+  }
+  return json::serialize(json::object{
+      {"type", "FeatureCollection"},
+      {"metadata", std::move(metadata)},
+      {"features", utl::all(p.segments_) |
+                       utl::transform([&](const path::segment& s) {
+                         return json::object{
+                             {"type", "Feature"},
+                             {
+                                 "properties",
+                                 {{"level", s.from_level_.to_float()},
+                                  {"osm_way_id", get_osm_way_id(w, s)},
+                                  {"cost", s.cost_},
+                                  {"distance", s.dist_}},
+                             },
+                             {"geometry", to_line_string(s.polyline_)}};
+                       }) |
+                       utl::emplace_back_to<json::array>()}});
+}
+
+std::string write_geojson_stream(ways const& w,
+                                 path const& p,
+                                 bool const with_stats) {
+  auto out = std::string{};
+  auto it = std::back_inserter(out);
+  fmt::format_to(it,
+                 R"({{"type":"FeatureCollection",)"
+                 R"("metadata":{{"duration":{},"distance":{})",
+                 p.cost_, p.dist_);
+  if (with_stats) {
+    out.append(R"(,"stats":)");
+    out.append(boost::json::serialize(to_json(p.stats_)));
+  }
+  out.append(R"(},"features":[)");
+  auto first_segment = true;
+  for (auto const& s : p.segments_) {
+    if (!first_segment) {
+      out.push_back(',');
+    }
+    first_segment = false;
+    fmt::format_to(it,
+                   R"({{"type":"Feature","properties":{{"level":{},)"
+                   R"("osm_way_id":{},"cost":{},"distance":{}}},)"
+                   R"("geometry":{{"type":"LineString","coordinates":[)",
+                   s.from_level_.to_float(), get_osm_way_id(w, s), s.cost_,
+                   s.dist_);
+    auto first_coord = true;
+    for (auto const& c : s.polyline_) {
+      if (!first_coord) {
+        out.push_back(',');
+      }
+      first_coord = false;
+      fmt::format_to(it, "[{},{}]", c.lng(), c.lat());
+    }
+    out.append("]}}");
+  }
+  out.append("]}");
+  return out;
+}
+
+std::string write_polyline(ways const& w,
+                           path const& p,
+                           unsigned const precision,
+                           bool const with_stats) {
+  auto out = std::string{};
+  auto it = std::back_inserter(out);
+  fmt::format_to(it, R"({{"duration":{},"distance":{},"precision":{},)",
+                 p.cost_, p.dist_, precision);
+  if (with_stats) {
+    out.append(R"("stats":)");
+    out.append(boost::json::serialize(to_json(p.stats_)));
+    out.push_back(',');
+  }
+  out.append(R"("segments":[)");
+  auto encoded = std::string{};
+  auto first_segment = true;
+  for (auto const& s : p.segments_) {
+    if (!first_segment) {
+      out.push_back(',');
+    }
+    first_segment = false;
+    fmt::format_to(it,
+                   R"({{"level":{},"osm_way_id":{},"cost":{},"distance":{},)"
+                   R"("polyline":")",
+                   s.from_level_.to_float(), get_osm_way_id(w, s), s.cost_,
+                   s.dist_);
+    encoded.clear();
+    encode_polyline(encoded, s.polyline_, precision);
+    for (auto const c : encoded) {
+      if (c == '\\') {  // only character of the encoding that needs escaping
+        out.push_back('\\');
+      }
+      out.push_back(c);
+    }
+    out.append("\"}");
+  }
+  out.append("]}");
+  return out;
+}
+
+std::string write_binary(ways const& w, path const& p) {
+  auto r = route_binary{.duration_ = p.cost_, .distance_ = p.dist_};
+  r.segments_.reserve(p.segments_.size());
+  for (auto const& s : p.segments_) {
+    for (auto const& c : s.polyline_) {
+      auto const l = point::from_latlng(c).as_location();
+      r.coordinates_.push_back({l.x(), l.y()});
+    }
+    r.segments_.push_back(route_binary::segment{
+        .osm_way_id_ = get_osm_way_id(w, s),
+        .level_ = s.from_level_.to_float(),
+        .cost_ = s.cost_,
+        .distance_ = s.dist_,
+        .coordinates_end_ =
+            static_cast<std::uint32_t>(r.coordinates_.size())});
+  }
+  auto const buf = cista::serialize<cista::mode::NONE>(r);
+  return {begin(buf), end(buf)};
+}
+
+std::string write_route(ways const& w,
+                        path const& p,
+                        route_format const format,
+                        unsigned const polyline_precision,
+                        bool const with_stats) {
+  switch (format) {
+    case route_format::kGeoJson: return write_geojson(w, p, with_stats);
+    case route_format::kGeoJsonStream:
+      return write_geojson_stream(w, p, with_stats);
+    case route_format::kPolyline:
+      return write_polyline(w, p, polyline_precision, with_stats);
+    case route_format::kBinary: return write_binary(w, p);
+  }
+  std::unreachable();
+}
+
+}  // namespace osr::backend
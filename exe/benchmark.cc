@@ -1,27 +1,40 @@
+#include <algorithm>
+#include <atomic>
+#include <bit>
 #include <chrono>
 #include <filesystem>
-#include <memory>
-#include <mutex>
+#include <fstream>
+#include <iostream>
+#include <iterator>
 #include <numeric>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
 #include <thread>
 #include <vector>
 
-#include "boost/asio/executor_work_guard.hpp"
-#include "boost/asio/io_context.hpp"
+#include "boost/json.hpp"
 
 #include "fmt/core.h"
+#include "fmt/ostream.h"
 #include "fmt/std.h"
 
 #include "conf/options_parser.h"
 
-#include "utl/timer.h"
+#include "utl/enumerate.h"
+#include "utl/helpers/algorithm.h"
+#include "utl/parser/cstr.h"
+#include "utl/to_vec.h"
+#include "utl/verify.h"
+#include "utl/zip.h"
+
+#include "geo/box.h"
 
 #include "osr/lookup.h"
-#include "osr/routing/dijkstra.h"
 #include "osr/routing/profile.h"
-#include "osr/routing/profiles/bike.h"
-#include "osr/routing/profiles/car.h"
 #include "osr/routing/route.h"
+#include "osr/routing/sharing_data.h"
 #include "osr/types.h"
 #include "osr/ways.h"
 
@@ -33,74 +46,463 @@ public:
   explicit settings() : configuration("Options") {
     param(data_dir_, "data,d", "Data directory");
     param(threads_, "threads,t", "Number of routing threads");
-    param(n_queries_, ",n", "Number of queries");
-    param(max_dist_, "radius,r", "Radius");
+    param(n_queries_, ",n", "Number of queries per profile and mode");
+    param(max_, "max,m", "Maximum cost (seconds)");
+    param(profiles_, "profiles,p",
+          "Comma separated list of profiles or \"all\"");
+    param(mode_, "mode", "one_to_one, one_to_many or both");
+    param(n_targets_, "targets", "Number of targets for one_to_many");
+    param(max_match_distance_, "max_match_distance",
+          "Maximum snapping distance (meters)");
+    param(max_distance_, "radius,r",
+          "Maximum beeline distance between start and target (meters), "
+          "0 = whole bounding box");
+    param(seed_, "seed", "Seed for the query generation");
+    param(save_queries_, "save_queries", "Write the query set to this file");
+    param(load_queries_, "load_queries",
+          "Replay the query set from this file instead of generating one");
+    param(csv_, "csv", "Write one line per query to this CSV file");
+    param(json_, "json", "Write the results to this JSON file");
+    param(baseline_, "baseline", "Compare: JSON results of the baseline");
+    param(candidate_, "candidate", "Compare: JSON results of the candidate");
+    param(threshold_, "threshold",
+          "Compare: slowdown in percent that is reported as regression");
   }
 
   fs::path data_dir_{"osr"};
-  unsigned n_queries_{50};
-  unsigned max_dist_{1200};
   unsigned threads_{std::thread::hardware_concurrency()};
+  unsigned n_queries_{50U};
+  unsigned max_{3600U};
+  std::string profiles_{"all"};
+  std::string mode_{"both"};
+  unsigned n_targets_{100U};
+  double max_match_distance_{100.0};
+  double max_distance_{20'000.0};
+  unsigned seed_{0U};
+  fs::path save_queries_;
+  fs::path load_queries_;
+  fs::path csv_;
+  fs::path json_;
+  fs::path baseline_;
+  fs::path candidate_;
+  double threshold_{10.0};
 };
 
-struct benchmark_result {
-  friend std::ostream& operator<<(std::ostream& out,
-                                  benchmark_result const& br) {
-    using double_milliseconds_t =
-        std::chrono::duration<double, std::ratio<1, 1000>>;
-    out << "(duration: " << std::fixed << std::setprecision(3) << std::setw(10)
-        << std::chrono::duration_cast<double_milliseconds_t>(br.duration_)
-               .count()
-        << "ms)";
-    return out;
+enum class query_mode : std::uint8_t { kOneToOne, kOneToMany };
+
+std::string_view to_str(query_mode const m) {
+  return m == query_mode::kOneToOne ? "one_to_one" : "one_to_many";
+}
+
+query_mode to_mode(std::string_view s) {
+  switch (cista::hash(s)) {
+    case cista::hash("one_to_one"): return query_mode::kOneToOne;
+    case cista::hash("one_to_many"): return query_mode::kOneToMany;
   }
+  throw utl::fail("{} is not a valid mode", s);
+}
 
-  std::chrono::microseconds duration_;
+struct query {
+  location from_;
+  std::vector<location> to_;
 };
 
+struct query_result {
+  using duration_t = search_stats::duration_t;
+
+  bool found() const { return n_found_ != 0U; }
+
+  duration_t match_time_{};
+  duration_t search_time_{};
+  duration_t reconstruct_time_{};
+  duration_t total_time_{};
+  std::uint64_t n_settled_{0U};
+  std::uint64_t n_pushed_{0U};
+  unsigned n_found_{0U};
+  cost_t cost_{kInfeasible};  // best target
+  std::vector<cost_t> costs_;  // per target, kInfeasible = not found
+};
+
+struct run {
+  search_profile profile_;
+  query_mode mode_;
+  cost_t max_;
+  std::vector<query> queries_;
+  std::vector<query_result> results_;
+};
+
+// The bounding box is estimated from a sample of the nodes to avoid touching
+// every node position of large extracts.
+geo::box get_bbox(ways const& w) {
+  constexpr auto const kMaxSamples = 100'000U;
+  auto const n = w.n_nodes();
+  auto const step = std::max(1U, n / kMaxSamples);
+  auto b = geo::box{};
+  for (auto i = 0U; i < n; i += step) {
+    b.extend(w.get_node_pos(node_idx_t{i}).as_latlng());
+  }
+  return b;
+}
+
+std::vector<query> generate_queries(lookup const& l,
+                                    geo::box const& bbox,
+                                    settings const& opt,
+                                    search_profile const profile,
+                                    query_mode const mode) {
+  constexpr auto const kMaxTries = 10'000U;
+
+  auto rng = std::mt19937_64{};
+  auto lat = std::uniform_real_distribution{bbox.min_.lat_, bbox.max_.lat_};
+  auto lng = std::uniform_real_distribution{bbox.min_.lng_, bbox.max_.lng_};
+
+  auto const matches = [&](location const& x, bool const reverse) {
+    return !l.match(x, reverse, direction::kForward, opt.max_match_distance_,
+                    nullptr, profile)
+                .empty();
+  };
+
+  auto const random_location = [&](std::optional<location> const& near,
+                                   bool const reverse) {
+    for (auto i = 0U; i != kMaxTries; ++i) {
+      auto const x = location{{lat(rng), lng(rng)}, kNoLevel};
+      if (near.has_value() && opt.max_distance_ != 0.0 &&
+          geo::distance(near->pos_, x.pos_) > opt.max_distance_) {
+        continue;
+      }
+      if (matches(x, reverse)) {
+        return x;
+      }
+    }
+    throw utl::fail("no matchable location found for profile {}",
+                    to_str(profile));
+  };
+
+  auto const n_targets = mode == query_mode::kOneToOne ? 1U : opt.n_targets_;
+  auto queries = std::vector<query>(opt.n_queries_);
+  for (auto const [i, q] : utl::enumerate(queries)) {
+    // Seeded per query: query i is the same regardless of n and threads.
+    rng.seed(cista::hash_combine(cista::BASE_HASH, opt.seed_,
+                                 static_cast<unsigned>(profile),
+                                 static_cast<unsigned>(mode), i));
+    q.from_ = random_location(std::nullopt, false);
+    q.to_.resize(n_targets);
+    for (auto& t : q.to_) {
+      t = random_location(q.from_, true);
+    }
+  }
+  return queries;
+}
+
+std::uint64_t get_query_set_hash(run const& x) {
+  auto h = cista::hash_combine(cista::BASE_HASH,
+                               static_cast<unsigned>(x.profile_),
+                               static_cast<unsigned>(x.mode_), x.max_);
+  auto const add = [&](location const& l) {
+    h = cista::hash_combine(h, std::bit_cast<std::uint64_t>(l.pos_.lat_),
+                            std::bit_cast<std::uint64_t>(l.pos_.lng_),
+                            to_idx(l.lvl_));
+  };
+  for (auto const& q : x.queries_) {
+    add(q.from_);
+    for (auto const& t : q.to_) {
+      add(t);
+    }
+  }
+  return h;
+}
+
+// Level null = kNoLevel (to_float() would turn it into level 0).
+boost::json::array to_json(location const& l) {
+  return {l.pos_.lat_, l.pos_.lng_,
+          l.lvl_ == kNoLevel ? boost::json::value{nullptr}
+                             : boost::json::value{l.lvl_.to_float()}};
+}
+
+location to_location(boost::json::value const& v) {
+  auto const& a = v.as_array();
+  utl::verify(a.size() == 3U, "query set: expected [lat, lng, level]");
+  return {{a[0].to_number<double>(), a[1].to_number<double>()},
+          a[2].is_null() ? kNoLevel : level_t{a[2].to_number<float>()}};
+}
+
+void write_query_set(fs::path const& p, std::vector<run> const& runs) {
+  auto out = std::ofstream{p};
+  utl::verify(out.good(), "could not open {}", p);
+  auto json = boost::json::array{};
+  for (auto const& x : runs) {
+    auto queries = boost::json::array{};
+    for (auto const& q : x.queries_) {
+      auto to = boost::json::array{};
+      for (auto const& t : q.to_) {
+        to.emplace_back(to_json(t));
+      }
+      queries.emplace_back(
+          boost::json::object{{"from", to_json(q.from_)}, {"to", to}});
+    }
+    json.emplace_back(boost::json::object{{"profile", to_str(x.profile_)},
+                                          {"mode", to_str(x.mode_)},
+                                          {"max", x.max_},
+                                          {"queries", queries}});
+  }
+  out << json;
+}
+
+boost::json::value read_json(fs::path const& p) {
+  auto in = std::ifstream{p};
+  utl::verify(in.good(), "could not open {}", p);
+  return boost::json::parse(
+      std::string{std::istreambuf_iterator<char>{in}, {}});
+}
+
+std::vector<run> read_query_set(fs::path const& p) {
+  return utl::to_vec(read_json(p).as_array(), [](boost::json::value const& v) {
+    auto const& o = v.as_object();
+    return run{
+        .profile_ = to_profile(o.at("profile").as_string()),
+        .mode_ = to_mode(o.at("mode").as_string()),
+        .max_ = o.at("max").to_number<cost_t>(),
+        .queries_ = utl::to_vec(o.at("queries").as_array(),
+                                [](boost::json::value const& q) {
+                                  auto const& qo = q.as_object();
+                                  return query{
+                                      .from_ = to_location(qo.at("from")),
+                                      .to_ = utl::to_vec(qo.at("to").as_array(),
+                                                         to_location)};
+                                }),
+        .results_ = {}};
+  });
+}
+
+query_result run_query(ways const& w,
+                       lookup const& l,
+                       settings const& opt,
+                       sharing_data const* sharing,
+                       run const& x,
+                       query const& q) {
+  auto const dir = direction::kForward;
+  auto const profile = x.profile_;
+  auto const max = x.max_;
+  auto r = query_result{};
+
+  auto const start = search_clock::now();
+  auto const from_match =
+      l.match(q.from_, false, dir, opt.max_match_distance_, nullptr, profile);
+  auto const to_match = utl::to_vec(q.to_, [&](location const& t) {
+    return l.match(t, true, dir, opt.max_match_distance_, nullptr, profile);
+  });
+  r.match_time_ = elapsed_since(start);
+
+  auto const search_start = search_clock::now();
+  auto const add = [&](std::optional<path> const& p) {
+    r.costs_.push_back(p.has_value() ? p->cost_ : kInfeasible);
+    if (!p.has_value()) {
+      return;
+    }
+    ++r.n_found_;
+    r.cost_ = std::min(r.cost_, p->cost_);
+    r.n_settled_ = p->stats_.n_settled_;
+    r.n_pushed_ = p->stats_.n_pushed_;
+    r.reconstruct_time_ += p->stats_.reconstruct_time_;
+  };
+  if (x.mode_ == query_mode::kOneToOne) {
+    add(route(w, profile, q.from_, q.to_.front(), from_match,
+              to_match.front(), max, dir, nullptr, sharing));
+  } else {
+    for (auto const& p :
+         route(w, profile, q.from_, q.to_, from_match, to_match, max, dir,
+               nullptr, sharing, [](path const&) { return true; })) {
+      add(p);
+    }
+  }
+  r.search_time_ = elapsed_since(search_start) - r.reconstruct_time_;
+  r.total_time_ = elapsed_since(start);
+  return r;
+}
+
 // needs sorted vector
-benchmark_result quantile(std::vector<benchmark_result> const& v, double q) {
+template <typename T>
+T quantile(std::vector<T> const& v, double q) {
   q = std::clamp(q, 0.0, 1.0);
+  if (v.empty()) {
+    return T{};
+  }
   if (q == 1.0) {
     return v.back();
   }
   return v[static_cast<std::size_t>(v.size() * q)];
 }
 
-void print_result(std::vector<benchmark_result> const& var,
-                  std::string const& profile) {
-  auto const avg = benchmark_result{
-      std::accumulate(var.begin(), var.end(), std::chrono::microseconds{0U},
-                      [](auto&& sum, auto const& res) {
-                        return std::move(sum) + res.duration_;
-                      }) /
-      var.size()};
-  std::cout << "\n--- profile: " << profile << " --- (n = " << var.size() << ")"
-            << "\n  max: " << var.back() << "\n  avg: " << avg << "\n----------"
-            << "\n  10%: " << quantile(var, 0.1)
-            << "\n  20%: " << quantile(var, 0.2)
-            << "\n  30%: " << quantile(var, 0.3)
-            << "\n  40%: " << quantile(var, 0.4)
-            << "\n  50%: " << quantile(var, 0.5)
-            << "\n  60%: " << quantile(var, 0.6)
-            << "\n  70%: " << quantile(var, 0.7)
-            << "\n  80%: " << quantile(var, 0.8)
-            << "\n  90%: " << quantile(var, 0.9)
-            << "\n  99%: " << quantile(var, 0.99)
-            << "\n99.9%: " << quantile(var, 0.999)
-            << "\n-----------------------------\n";
+template <typename Fn>
+boost::json::object summarize(std::vector<query_result> const& results,
+                              Fn&& get) {
+  auto values = utl::to_vec(results, [&](query_result const& r) {
+    return static_cast<double>(get(r));
+  });
+  std::ranges::sort(values);
+  auto const avg =
+      values.empty()
+          ? 0.0
+          : std::accumulate(begin(values), end(values), 0.0) / values.size();
+  return {{"avg", avg},
+          {"p50", quantile(values, 0.5)},
+          {"p90", quantile(values, 0.9)},
+          {"p99", quantile(values, 0.99)},
+          {"max", quantile(values, 1.0)}};
 }
 
-template <typename T>
-void set_start(dijkstra<T>& d, ways const& w, node_idx_t const start) {
-  d.add_start(w, typename T::label{typename T::node{start}, 0U});
+boost::json::object summarize(run const& x) {
+  auto const n_found = std::ranges::count_if(
+      x.results_, [](query_result const& r) { return r.found(); });
+  auto const us = [](auto const member) {
+    return [member](query_result const& r) { return to_us(r.*member); };
+  };
+  return {{"profile", to_str(x.profile_)},
+          {"mode", to_str(x.mode_)},
+          {"queries", x.results_.size()},
+          {"found", n_found},
+          {"total_us", summarize(x.results_, us(&query_result::total_time_))},
+          {"match_us", summarize(x.results_, us(&query_result::match_time_))},
+          {"search_us", summarize(x.results_, us(&query_result::search_time_))},
+          {"reconstruct_us",
+           summarize(x.results_, us(&query_result::reconstruct_time_))},
+          {"settled", summarize(x.results_, [](query_result const& r) {
+             return r.n_settled_;
+           })}};
 }
 
-template <>
-void set_start<car>(dijkstra<car>& d, ways const& w, node_idx_t const start) {
-  d.add_start(w, car::label{car::node{start, 0, direction::kForward}, 0U});
-  d.add_start(w, car::label{car::node{start, 0, direction::kBackward}, 0U});
-};
+void print_summary(std::ostream& out, boost::json::object const& s) {
+  fmt::print(out, "\n--- profile: {}, mode: {} --- (n = {}, found = {})\n",
+             s.at("profile").as_string().c_str(),
+             s.at("mode").as_string().c_str(), s.at("queries").to_number<int>(),
+             s.at("found").to_number<int>());
+  fmt::print(out, "{:>16} {:>10} {:>10} {:>10} {:>10} {:>10}\n", "", "avg",
+             "p50", "p90", "p99", "max");
+  for (auto const key :
+       {"total_us", "match_us", "search_us", "reconstruct_us", "settled"}) {
+    auto const& v = s.at(key).as_object();
+    fmt::print(out,
+               "{:>16} {:>10.0f} {:>10.0f} {:>10.0f} {:>10.0f} {:>10.0f}\n",
+               key, v.at("avg").to_number<double>(),
+               v.at("p50").to_number<double>(), v.at("p90").to_number<double>(),
+               v.at("p99").to_number<double>(),
+               v.at("max").to_number<double>());
+  }
+}
+
+void write_csv(fs::path const& p, std::vector<run> const& runs) {
+  auto out = std::ofstream{p};
+  utl::verify(out.good(), "could not open {}", p);
+  out << "profile,mode,query,found,cost,match_us,search_us,reconstruct_us,"
+         "total_us,settled,pushed\n";
+  for (auto const& x : runs) {
+    for (auto const [i, r] : utl::enumerate(x.results_)) {
+      fmt::print(out, "{},{},{},{},{},{},{},{},{},{},{}\n", to_str(x.profile_),
+                 to_str(x.mode_), i, r.n_found_,
+                 r.found() ? std::to_string(r.cost_) : "",
+                 to_us(r.match_time_), to_us(r.search_time_),
+                 to_us(r.reconstruct_time_), to_us(r.total_time_),
+                 r.n_settled_, r.n_pushed_);
+    }
+  }
+}
+
+std::vector<search_profile> parse_profiles(std::string_view s) {
+  if (s == "all") {
+    return {search_profile::kFoot,
+            search_profile::kWheelchair,
+            search_profile::kBike,
+            search_profile::kCar,
+            search_profile::kCarParking,
+            search_profile::kCarParkingWheelchair,
+            search_profile::kBikeSharing};
+  }
+  auto profiles = std::vector<search_profile>{};
+  utl::for_each_token(utl::cstr{s.data(), s.size()}, ',',
+                      [&](utl::cstr const x) {
+                        profiles.push_back(to_profile(x.view()));
+                      });
+  return profiles;
+}
+
+std::vector<query_mode> parse_modes(std::string_view s) {
+  if (s == "both") {
+    return {query_mode::kOneToOne, query_mode::kOneToMany};
+  }
+  return {to_mode(s)};
+}
+
+boost::json::object to_json(run const& x) {
+  auto json = summarize(x);
+  json["query_set"] = fmt::format("{:016x}", get_query_set_hash(x));
+  auto& costs = json["costs"].emplace_array();
+  for (auto const& r : x.results_) {
+    auto& targets = costs.emplace_back(boost::json::array{}).as_array();
+    for (auto const c : r.costs_) {
+      if (c == kInfeasible) {
+        targets.emplace_back(nullptr);
+      } else {
+        targets.emplace_back(c);
+      }
+    }
+  }
+  return json;
+}
+
+// Returns true if the candidate regressed compared to the baseline.
+bool compare(fs::path const& baseline,
+             fs::path const& candidate,
+             double const threshold) {
+  auto const base = read_json(baseline);
+  auto const cand = read_json(candidate);
+
+  auto regression = false;
+  for (auto const& c : cand.as_array()) {
+    auto const& co = c.as_object();
+    auto const it = utl::find_if(base.as_array(), [&](auto const& b) {
+      return b.as_object().at("profile") == co.at("profile") &&
+             b.as_object().at("mode") == co.at("mode");
+    });
+    fmt::println("\n--- profile: {}, mode: {} ---",
+                 co.at("profile").as_string().c_str(),
+                 co.at("mode").as_string().c_str());
+    if (it == end(base.as_array())) {
+      fmt::println("  not in baseline");
+      continue;
+    }
+    auto const& bo = it->as_object();
+
+    for (auto const [metric, q] :
+         {std::pair{"total_us", "p50"}, std::pair{"total_us", "p90"},
+          std::pair{"total_us", "p99"}, std::pair{"settled", "avg"}}) {
+      auto const b = bo.at(metric).as_object().at(q).to_number<double>();
+      auto const v = co.at(metric).as_object().at(q).to_number<double>();
+      auto const change = b == 0.0 ? 0.0 : (v / b - 1.0) * 100.0;
+      auto const is_regression = change > threshold;
+      regression |= is_regression;
+      fmt::println("  {:>8} {:>3}: {:>12.0f} -> {:>12.0f} ({:+7.2f}%){}",
+                   metric, q, b, v, change,
+                   is_regression ? " REGRESSION" : "");
+    }
+
+    if (bo.at("query_set") != co.at("query_set")) {
+      fmt::println("  different query sets, costs not compared");
+      continue;
+    }
+    auto const& bc = bo.at("costs").as_array();
+    auto const& cc = co.at("costs").as_array();
+    auto n_different = 0U;
+    for (auto const [b, v] : utl::zip(bc, cc)) {
+      if (b != v) {
+        ++n_different;
+      }
+    }
+    regression |= n_different != 0U;
+    fmt::println("  queries with cost differences: {}/{}{}", n_different,
+                 cc.size(),
+                 n_different != 0U ? " REGRESSION" : "");
+  }
+  return regression;
+}
 
 int main(int argc, char const* argv[]) {
   auto opt = settings{};
@@ -118,55 +520,89 @@ int main(int argc, char const* argv[]) {
   parser.print_unrecognized(std::cout);
   parser.print_used(std::cout);
 
+  if (!opt.baseline_.empty() || !opt.candidate_.empty()) {
+    utl::verify(!opt.baseline_.empty() && !opt.candidate_.empty(),
+                "compare: baseline and candidate required");
+    return compare(opt.baseline_, opt.candidate_, opt.threshold_) ? 1 : 0;
+  }
+
   if (!fs::is_directory(opt.data_dir_)) {
     fmt::println("directory not found: {}", opt.data_dir_);
     return 1;
   }
 
   auto const w = ways{opt.data_dir_, cista::mmap::protection::READ};
+  auto const l = lookup{w, opt.data_dir_, cista::mmap::protection::READ};
+
+  auto runs = std::vector<run>{};
+  if (!opt.load_queries_.empty()) {
+    runs = read_query_set(opt.load_queries_);
+  } else {
+    auto const bbox = get_bbox(w);
+    for (auto const p : parse_profiles(opt.profiles_)) {
+      for (auto const m : parse_modes(opt.mode_)) {
+        runs.push_back(run{.profile_ = p,
+                           .mode_ = m,
+                           .max_ = static_cast<cost_t>(opt.max_),
+                           .queries_ = generate_queries(l, bbox, opt, p, m),
+                           .results_ = {}});
+      }
+    }
+  }
 
-  auto threads = std::vector<std::thread>(std::max(1U, opt.threads_));
-  auto results = std::vector<benchmark_result>{};
-  results.reserve(opt.n_queries_);
+  if (!opt.save_queries_.empty()) {
+    write_query_set(opt.save_queries_, runs);
+  }
+
+  // Bike sharing without real stations: every node is a station.
+  auto everywhere = bitvec<node_idx_t>{};
+  auto const no_additional_edges =
+      hash_map<node_idx_t, std::vector<additional_edge>>{};
+  if (utl::any_of(runs, [](run const& x) {
+        return x.profile_ == search_profile::kBikeSharing;
+      })) {
+    everywhere.resize(w.n_nodes());
+    for (auto i = 0U; i != w.n_nodes(); ++i) {
+      everywhere.set(node_idx_t{i}, true);
+    }
+  }
+  auto const sharing = sharing_data{.start_allowed_ = everywhere,
+                                    .end_allowed_ = everywhere,
+                                    .through_allowed_ = everywhere,
+                                    .additional_node_offset_ = w.n_nodes(),
+                                    .additional_edges_ = no_additional_edges};
+
+  for (auto& x : runs) {
+    x.results_.resize(x.queries_.size());
 
-  auto const run_benchmark = [&]<typename T>(const char* profile) {
-    results.clear();
-    auto i = std::atomic_size_t{0U};
-    auto m = std::mutex{};
+    auto next = std::atomic_size_t{0U};
+    auto threads = std::vector<std::thread>(std::max(1U, opt.threads_));
     for (auto& t : threads) {
       t = std::thread([&]() {
-        auto d = dijkstra<T>{};
-        auto h = cista::BASE_HASH;
-        auto n = 0U;
-        while (i.fetch_add(1U) < opt.n_queries_) {
-          auto const start_time = std::chrono::steady_clock::now();
-          auto const start =
-              node_idx_t{cista::hash_combine(h, ++n, i.load()) % w.n_nodes()};
-          d.reset(opt.max_dist_);
-          set_start<T>(d, w, start);
-          d.template run<direction::kForward, false>(w, *w.r_, opt.max_dist_,
-                                                     nullptr, nullptr);
-          auto const end_time = std::chrono::steady_clock::now();
-          {
-            auto const guard = std::lock_guard{m};
-            results.emplace_back(benchmark_result{std::chrono::duration_cast<
-                decltype(benchmark_result::duration_)>(end_time - start_time)});
-          }
+        for (auto i = next.fetch_add(1U); i < x.queries_.size();
+             i = next.fetch_add(1U)) {
+          x.results_[i] = run_query(w, l, opt, &sharing, x, x.queries_[i]);
         }
       });
     }
-
     for (auto& t : threads) {
       t.join();
     }
 
-    std::ranges::sort(results, std::less<>{}, [](benchmark_result const& res) {
-      return res.duration_;
-    });
+    print_summary(std::cout, summarize(x));
+  }
 
-    print_result(results, profile);
-  };
+  if (!opt.csv_.empty()) {
+    write_csv(opt.csv_, runs);
+  }
 
-  run_benchmark.template operator()<car>("car");
-  run_benchmark.template operator()<bike>("bike");
+  if (!opt.json_.empty()) {
+    auto out = std::ofstream{opt.json_};
+    utl::verify(out.good(), "could not open {}", opt.json_);
+    auto json = boost::json::array{};
+    for (auto const& x : runs) {
+      json.emplace_back(to_json(x));
+    }
+    out << json;
+  }
 }
@@ -8,6 +8,8 @@
 #include "utl/progress_tracker.h"
 
 #include "osr/extract/extract.h"
+#include "osr/extract/region.h"
+#include "osr/extract/update.h"
 
 using namespace osr;
 using namespace boost::program_options;
@@ -19,10 +21,29 @@ struct config : public conf::configuration {
     param(in_, "in,i", "OpenStreetMap .osm.pbf input path");
     param(out_, "out,o", "output directory");
     param(with_platforms_, "with_platforms,p", "extract platform info");
+    param(bbox_, "bbox",
+          "only extract ways touching min_lng,min_lat,max_lng,max_lat");
+    param(poly_, "poly", "only extract ways touching this .poly polygon");
+    param(memory_hint_mb_, "memory_hint",
+          "available RAM in MB (best-effort, not a limit): spills staged "
+          "nodes to disk, fewer buffers in flight (0 = unknown)");
+    param(node_index_, "node_index",
+          "node coordinate storage: auto|dense-mem|sparse-mem|hybrid-file");
+    param(pack_geometry_, "pack_geometry",
+          "store way geometries delta varint coded (less disk space)");
+    param(checkpoint_, "checkpoint",
+          "write checkpoints after each phase, resume from the last one");
+    param(update_, "update,u",
+          "apply OpenStreetMap change file (.osc) to the output directory "
+          "instead of a full extract");
   }
 
-  std::filesystem::path in_, out_;
+  std::filesystem::path in_, out_, update_, poly_;
+  std::string bbox_, node_index_{"auto"};
+  std::size_t memory_hint_mb_{0U};
   bool with_platforms_{false};
+  bool checkpoint_{false};
+  bool pack_geometry_{false};
 };
 
 int main(int ac, char const** av) {
@@ -36,6 +57,24 @@ int main(int ac, char const** av) {
   parser.print_unrecognized(std::cout);
   parser.print_used(std::cout);
 
+  if (!c.update_.empty()) {
+    auto const s = update(c.update_, c.out_);
+    fmt::println(
+        "ways: {} properties, {} deleted, nodes: {} properties, {} moved, "
+        "geometries: {}",
+        s.n_way_properties_, s.n_deleted_ways_, s.n_node_properties_,
+        s.n_moved_nodes_, s.n_geometries_);
+    if (s.requires_full_extract()) {
+      fmt::println(
+          "full extract required: {} new ways, {} topology changes, "
+          "{} relation changes, {} node changes",
+          s.n_new_ways_, s.n_topology_changes_, s.n_relation_changes_,
+          s.n_node_changes_);
+      return 2;
+    }
+    return 0;
+  }
+
   if (!fs::is_regular_file(c.in_)) {
     fmt::println("input file {} not found", c.in_);
     return 1;
@@ -44,5 +83,15 @@ int main(int ac, char const** av) {
   utl::activate_progress_tracker("osr");
   auto const silencer = utl::global_progress_bars{false};
 
-  extract(c.with_platforms_, c.in_, c.out_);
+  auto opt =
+      extract_options{.with_platforms_ = c.with_platforms_,
+                      .poly_ = c.poly_,
+                      .memory_hint_ = c.memory_hint_mb_ * 1024U * 1024U,
+                      .node_index_ = parse_node_index_type(c.node_index_),
+                      .pack_geometry_ = c.pack_geometry_,
+                      .checkpoint_ = c.checkpoint_};
+  if (!c.bbox_.empty()) {
+    opt.bbox_ = parse_bbox(c.bbox_);
+  }
+  extract(opt, c.in_, c.out_);
 }
\ No newline at end of file
@@ -0,0 +1,105 @@
+#include <cmath>
+#include <filesystem>
+#include <iostream>
+
+#include "fmt/core.h"
+#include "fmt/std.h"
+
+#include "conf/options_parser.h"
+
+#include "utl/progress_tracker.h"
+#include "utl/verify.h"
+
+#include "osr/extract/extract.h"
+#include "osr/extract/synthetic.h"
+
+using namespace osr;
+namespace fs = std::filesystem;
+
+struct config : public conf::configuration {
+  config() : configuration{"Options"} {
+    param(out_, "out,o", "output directory");
+    param(osm_, "osm",
+          "intermediate OSM file outside of out (default: <out>.osm.pbf)");
+    param(keep_osm_, "keep_osm", "keep the intermediate OSM file");
+    param(n_nodes_, "nodes,n",
+          "approximate number of intersections (square grid, overrides "
+          "rows/cols)");
+    param(o_.n_rows_, "rows", "grid rows");
+    param(o_.n_cols_, "cols", "grid columns");
+    param(o_.spacing_, "spacing", "distance between intersections (meters)");
+    param(o_.delete_probability_, "delete", "probability to drop a segment");
+    param(o_.oneway_probability_, "oneway",
+          "probability for a residential way to be oneway");
+    param(o_.secondary_every_, "secondary_every",
+          "every n-th row/column is secondary (0 = none)");
+    param(o_.primary_every_, "primary_every",
+          "every n-th row/column is primary (0 = none)");
+    param(o_.n_buildings_, "buildings", "number of multi-level buildings");
+    param(o_.n_levels_, "levels", "levels per building (1-4)");
+    param(o_.n_restrictions_, "restrictions", "number of turn restrictions");
+    param(o_.platform_probability_, "platforms",
+          "probability for an intersection to be a platform");
+    param(o_.seed_, "seed", "random seed");
+  }
+
+  fs::path out_{"osr"};
+  fs::path osm_;
+  bool keep_osm_{false};
+  std::uint64_t n_nodes_{0U};
+  synthetic_options o_;
+};
+
+int main(int ac, char const** av) {
+  auto c = config{};
+
+  conf::options_parser parser({&c});
+  parser.read_command_line_args(ac, av);
+
+  if (parser.help()) {
+    parser.print_help(std::cout);
+    return 0;
+  } else if (parser.version()) {
+    return 0;
+  }
+
+  parser.read_configuration_file();
+
+  parser.print_unrecognized(std::cout);
+  parser.print_used(std::cout);
+
+  if (c.n_nodes_ != 0U) {
+    auto const side = static_cast<std::uint32_t>(
+        std::ceil(std::sqrt(static_cast<double>(c.n_nodes_))));
+    c.o_.n_rows_ = side;
+    c.o_.n_cols_ = side;
+  }
+
+  // extract() clears the output directory before reading the input.
+  auto out = c.out_.lexically_normal();
+  if (!out.has_filename()) {
+    out = out.parent_path();
+  }
+  auto osm = c.osm_;
+  if (osm.empty()) {
+    osm = out;
+    osm += ".osm.pbf";
+  }
+  auto const rel = fs::absolute(osm).lexically_normal().lexically_relative(
+      fs::absolute(out).lexically_normal());
+  utl::verify(rel.empty() || *rel.begin() == "..",
+              "osm file {} must not be in the output directory", osm);
+
+  fmt::println("writing {}x{} grid to {}", c.o_.n_rows_, c.o_.n_cols_, osm);
+  write_synthetic_osm(c.o_, osm);
+
+  utl::activate_progress_tracker("osr");
+  auto const silencer = utl::global_progress_bars{false};
+
+  extract(c.o_.platform_probability_ != 0.0, osm, c.out_);
+
+  if (!c.keep_osm_) {
+    auto ec = std::error_code{};
+    fs::remove(osm, ec);
+  }
+}
@@ -0,0 +1,498 @@
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cinttypes>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "fmt/core.h"
+#include "fmt/std.h"
+
+#include "conf/options_parser.h"
+
+#include "utl/to_vec.h"
+#include "utl/verify.h"
+
+#include "osr/extract/extract.h"
+#include "osr/geojson.h"
+#include "osr/lookup.h"
+#include "osr/routing/dial.h"
+#include "osr/routing/profile.h"
+#include "osr/routing/profiles/bike.h"
+#include "osr/routing/profiles/car.h"
+#include "osr/routing/profiles/foot.h"
+#include "osr/routing/route.h"
+#include "osr/types.h"
+#include "osr/util/delta_varint.h"
+#include "osr/ways.h"
+
+namespace fs = std::filesystem;
+using namespace osr;
+
+class settings : public conf::configuration {
+public:
+  explicit settings() : configuration("Options") {
+    param(data_dir_, "data,d",
+          "Data directory (if empty: extract --in to a temporary directory)");
+    param(in_, "in,i", "OSM input file used if no data directory is given");
+    param(filter_, "filter,f", "Only run benchmarks containing this string");
+    param(n_samples_, "samples,s", "Number of sampled nodes/ways");
+    param(n_repetitions_, "repetitions,r", "Repetitions per benchmark");
+    param(pack_geometry_, "pack_geometry",
+          "Extract with packed way geometries (only without --data)");
+    param(drop_page_cache_, "drop_page_cache",
+          "Evict --data files from the page cache to measure the footprint "
+          "(always done for the temporary extract)");
+  }
+
+  fs::path data_dir_;
+  fs::path in_{"test/map.osm"};
+  std::string filter_;
+  unsigned n_samples_{10'000U};
+  unsigned n_repetitions_{10U};
+  bool pack_geometry_{false};
+  bool drop_page_cache_{false};
+};
+
+// Removes the temporary data directory (if any) on exit.
+struct tmp_dir {
+  ~tmp_dir() {
+    if (!path_.empty()) {
+      auto ec = std::error_code{};
+      fs::remove_all(path_, ec);
+    }
+  }
+  fs::path path_;
+};
+
+// Results are folded into this value so the compiler can not drop the work.
+volatile std::uint64_t sink = 0U;
+
+struct benchmark {
+  using ns_t = std::chrono::duration<double, std::nano>;
+
+  // fn(checksum) -> number of operations, timed from the outside.
+  template <typename Fn>
+  void run(std::string_view name, Fn&& fn) {
+    measure(name, [&](std::uint64_t& checksum) {
+      auto const start = std::chrono::steady_clock::now();
+      auto const n_ops = static_cast<std::uint64_t>(fn(checksum));
+      return std::pair{n_ops, ns_t{std::chrono::steady_clock::now() - start}};
+    });
+  }
+
+  // fn(checksum) -> (number of operations, time spent in the operations)
+  template <typename Fn>
+  void measure(std::string_view name, Fn&& fn) {
+    if (!opt_.filter_.empty() && name.find(opt_.filter_) == name.npos) {
+      return;
+    }
+
+    auto checksum = std::uint64_t{0U};
+    fn(checksum);  // warm up
+
+    auto ns_per_op = std::vector<double>{};
+    auto n_ops = std::uint64_t{0U};
+    for (auto i = 0U; i != std::max(1U, opt_.n_repetitions_); ++i) {
+      auto const [n, time] = fn(checksum);
+      n_ops = n;
+      ns_per_op.push_back(n_ops == 0U ? 0.0 : ns_t{time}.count() / n_ops);
+    }
+    sink = sink + checksum;
+
+    std::ranges::sort(ns_per_op);
+    fmt::println("{:<32} {:>10} {:>12.1f} {:>12.1f} {:>12.1f}", name, n_ops,
+                 ns_per_op.front(), ns_per_op[ns_per_op.size() / 2U],
+                 ns_per_op.back());
+  }
+
+  settings const& opt_;
+};
+
+struct identity_bucket {
+  cost_t operator()(cost_t const x) const { return x; }
+};
+
+template <typename Profile>
+std::vector<typename Profile::node> sample_nodes(
+    ways const& w, std::vector<node_idx_t> const& nodes) {
+  auto sampled = std::vector<typename Profile::node>{};
+  for (auto const n : nodes) {
+    Profile::resolve_all(*w.r_, n, kNoLevel,
+                         [&](auto const x) { sampled.push_back(x); });
+  }
+  return sampled;
+}
+
+template <typename Profile>
+void run_adjacent(benchmark& b,
+                  std::string_view name,
+                  ways const& w,
+                  std::vector<node_idx_t> const& nodes) {
+  auto const sampled = sample_nodes<Profile>(w, nodes);
+  b.run(name, [&](std::uint64_t& checksum) {
+    for (auto const n : sampled) {
+      Profile::template adjacent<direction::kForward, false>(
+          *w.r_, n, nullptr, nullptr,
+          [&](auto const, std::uint32_t const cost, auto&&...) {
+            checksum += cost;
+          });
+    }
+    return sampled.size();
+  });
+}
+
+template <typename Profile>
+void run_match(benchmark& b,
+               std::string_view name,
+               lookup const& l,
+               std::vector<location> const& locations) {
+  b.run(name, [&](std::uint64_t& checksum) {
+    for (auto const& x : locations) {
+      checksum += l.match<Profile>(x, false, direction::kForward, 100.0,
+                                   nullptr)
+                      .size();
+    }
+    return locations.size();
+  });
+}
+
+constexpr auto const kRawGeometryFiles = std::array{
+    "way_polylines_data.bin", "way_polylines_index.bin",
+    "way_osm_nodes_data.bin", "way_osm_nodes_index.bin"};
+constexpr auto const kPackedGeometryFiles = std::array{
+    "way_polylines_packed_data.bin", "way_polylines_packed_index.bin",
+    "way_osm_nodes_packed_data.bin", "way_osm_nodes_packed_index.bin"};
+
+#if defined(__linux__)
+
+// Bytes of the file that are in the page cache.
+std::uint64_t page_cache_bytes(fs::path const& p) {
+  auto ec = std::error_code{};
+  auto const size = fs::file_size(p, ec);
+  auto const fd = ::open(p.c_str(), O_RDONLY);
+  if (ec || size == 0U || fd == -1) {
+    if (fd != -1) {
+      ::close(fd);
+    }
+    return 0U;
+  }
+
+  auto n = std::uint64_t{0U};
+  auto const addr = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  if (addr != MAP_FAILED) {
+    auto const page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    auto pages = std::vector<unsigned char>((size + page - 1U) / page);
+    if (::mincore(addr, size, pages.data()) == 0) {
+      n = static_cast<std::uint64_t>(std::ranges::count_if(
+              pages, [](unsigned char const x) { return (x & 1U) != 0U; })) *
+          page;
+    }
+    ::munmap(addr, size);
+  }
+  ::close(fd);
+  return n;
+}
+
+// Writes back and evicts the file from the page cache (not mapped pages).
+void drop_page_cache(fs::path const& p) {
+  auto const fd = ::open(p.c_str(), O_RDONLY);
+  if (fd != -1) {
+    ::fdatasync(fd);
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    ::close(fd);
+  }
+}
+
+#endif
+
+// Storage and page cache footprint of the way geometry (raw or packed, the
+// other one is empty). The page cache footprint is measured for the full
+// route path (match + search + add_path) starting with a cold cache.
+// Evicting is only done for the temporary extract or if requested.
+void report_footprint(settings const& opt, bool const drop_page_cache) {
+  auto const sum = [&](auto const& files, auto&& get) {
+    auto n = std::uint64_t{0U};
+    for (auto const file : files) {
+      n += get(opt.data_dir_ / file);
+    }
+    return n;
+  };
+  auto const disk = [](fs::path const& p) {
+    auto ec = std::error_code{};
+    auto const size = fs::file_size(p, ec);
+    return ec ? std::uint64_t{0U} : static_cast<std::uint64_t>(size);
+  };
+  fmt::println("way geometry on disk: raw {} bytes, packed {} bytes",
+               sum(kRawGeometryFiles, disk), sum(kPackedGeometryFiles, disk));
+
+#if defined(__linux__)
+  if (!drop_page_cache) {  // never evict the data of a running server
+    fmt::println("page cache footprint: skipped, see --drop_page_cache");
+    return;
+  }
+
+  // Sample before the cache is dropped: get_node_pos reads the geometry.
+  auto locations = std::vector<std::pair<location, location>>{};
+  {
+    auto const w = ways{opt.data_dir_, cista::mmap::protection::READ};
+    auto rng = std::mt19937_64{7U};
+    auto const random_location = [&]() {
+      auto const n = static_cast<node_idx_t::value_t>(rng() % w.n_nodes());
+      return location{w.get_node_pos(node_idx_t{n}), kNoLevel};
+    };
+    for (auto i = 0U; i != std::min(opt.n_samples_, 200U); ++i) {
+      auto const from = random_location();
+      locations.emplace_back(from, random_location());
+    }
+  }
+
+  auto files = std::vector<fs::path>{};
+  for (auto const& e : fs::directory_iterator{opt.data_dir_}) {
+    if (e.is_regular_file()) {
+      files.push_back(e.path());
+      drop_page_cache(e.path());
+    }
+  }
+
+  {
+    auto const w = ways{opt.data_dir_, cista::mmap::protection::READ};
+    auto const l = lookup{w, opt.data_dir_, cista::mmap::protection::READ};
+    for (auto const& [from, to] : locations) {
+      for (auto const profile : {search_profile::kFoot, search_profile::kCar}) {
+        auto const p =
+            route(w, l, profile, from, to, 900U, direction::kForward, 100.0);
+        sink = sink + (p.has_value() ? p->cost_ : 0U);
+      }
+    }
+  }
+
+  auto const cached = [&](fs::path const& p) { return page_cache_bytes(p); };
+  auto total = std::uint64_t{0U};
+  for (auto const& f : files) {
+    total += page_cache_bytes(f);
+  }
+  fmt::println(
+      "page cache after {} foot + car routes: raw geometry {} bytes, packed "
+      "geometry {} bytes, all files {} bytes",
+      locations.size(), sum(kRawGeometryFiles, cached),
+      sum(kPackedGeometryFiles, cached), total);
+#else
+  fmt::println("page cache footprint: not supported on this platform");
+#endif
+}
+
+int main(int argc, char const* argv[]) {
+  auto opt = settings{};
+  auto parser = conf::options_parser({&opt});
+  parser.read_command_line_args(argc, argv);
+
+  if (parser.help()) {
+    parser.print_help(std::cout);
+    return 0;
+  } else if (parser.version()) {
+    return 0;
+  }
+
+  parser.read_configuration_file();
+  parser.print_unrecognized(std::cout);
+  parser.print_used(std::cout);
+
+  // Declared before ways / lookup: removed after they are unmapped.
+  auto tmp = tmp_dir{};
+  if (opt.data_dir_.empty()) {
+    // Unique name: concurrent runs must not remove each other's data.
+    auto rd = std::random_device{};
+    do {
+      opt.data_dir_ = fs::temp_directory_path() /
+                      fmt::format("osr_microbenchmark_{:08x}", rd());
+    } while (!fs::create_directory(opt.data_dir_));
+    tmp.path_ = opt.data_dir_;
+    extract(extract_options{.pack_geometry_ = opt.pack_geometry_}, opt.in_,
+            opt.data_dir_);
+  }
+
+  report_footprint(opt, !tmp.path_.empty() || opt.drop_page_cache_);
+
+  auto const w = ways{opt.data_dir_, cista::mmap::protection::READ};
+  auto const l = lookup{w, opt.data_dir_, cista::mmap::protection::READ};
+  utl::verify(w.n_nodes() != 0U && w.n_ways() != 0U, "empty graph");
+
+  // Deterministic samples: same data + options = same work.
+  auto rng = std::mt19937_64{};
+  auto const nodes = utl::to_vec(
+      std::views::iota(0U, opt.n_samples_), [&](unsigned) {
+        return node_idx_t{static_cast<node_idx_t::value_t>(rng() %
+                                                           w.n_nodes())};
+      });
+  auto const sampled_ways = utl::to_vec(
+      std::views::iota(0U, opt.n_samples_), [&](unsigned) {
+        return way_idx_t{static_cast<way_idx_t::value_t>(rng() % w.n_ways())};
+      });
+  auto const locations = utl::to_vec(nodes, [&](node_idx_t const n) {
+    auto const pos = w.get_node_pos(n).as_latlng();
+    auto offset = std::uniform_real_distribution{-0.0002, 0.0002};
+    return location{{pos.lat_ + offset(rng), pos.lng_ + offset(rng)},
+                    kNoLevel};
+  });
+
+  auto b = benchmark{opt};
+  fmt::println("{:<32} {:>10} {:>12} {:>12} {:>12}", "benchmark", "ops",
+               "min ns/op", "median ns/op", "max ns/op");
+
+  // dial: Dijkstra-like pattern (pop min, push a few slightly larger labels)
+  // and fill-then-drain with random costs.
+  b.run("dial/dijkstra_pattern", [&](std::uint64_t& checksum) {
+    constexpr auto const kMax = cost_t{3600U};
+    auto pq = dial<cost_t, identity_bucket>{identity_bucket{}};
+    pq.n_buckets(kMax + 1U);
+    pq.clear();
+    auto r = std::mt19937{42U};
+    auto n_ops = std::uint64_t{0U};
+    pq.push(cost_t{0U});
+    while (!pq.empty() && n_ops < opt.n_samples_ * 10U) {
+      auto const c = pq.pop();
+      checksum += c;
+      ++n_ops;
+      for (auto i = 0U; i != 3U; ++i) {
+        auto const next = c + 1U + r() % 60U;
+        if (next < kMax) {
+          pq.push(static_cast<cost_t>(next));
+          ++n_ops;
+        }
+      }
+    }
+    return n_ops;
+  });
+  b.run("dial/fill_drain", [&](std::uint64_t& checksum) {
+    constexpr auto const kMax = cost_t{3600U};
+    auto pq = dial<cost_t, identity_bucket>{identity_bucket{}};
+    pq.n_buckets(kMax + 1U);
+    pq.clear();
+    auto r = std::mt19937{42U};
+    for (auto i = 0U; i != opt.n_samples_; ++i) {
+      pq.push(static_cast<cost_t>(r() % kMax));
+    }
+    while (!pq.empty()) {
+      checksum += pq.pop();
+    }
+    return std::uint64_t{opt.n_samples_} * 2U;
+  });
+
+  run_adjacent<foot<false>>(b, "adjacent/foot", w, nodes);
+  run_adjacent<bike>(b, "adjacent/bike", w, nodes);
+  run_adjacent<car>(b, "adjacent/car", w, nodes);
+
+  auto const osm_ids =
+      utl::to_vec(nodes, [&](node_idx_t const n) { return w.node_to_osm_[n]; });
+  b.run("ways/find_node_idx", [&](std::uint64_t& checksum) {
+    for (auto const id : osm_ids) {
+      checksum += to_idx(w.find_node_idx(id).value_or(node_idx_t{0U}));
+    }
+    return osm_ids.size();
+  });
+
+  // lookup::match = get_way_candidates + widening if nothing was found.
+  run_match<foot<false>>(b, "lookup/match/foot", l, locations);
+  run_match<car>(b, "lookup/match/car", l, locations);
+
+  // Geometry slicing done by add_path for every reconstructed edge.
+  if (!w.is_packed()) {
+    b.run("ways/way_node_polyline", [&](std::uint64_t& checksum) {
+      auto n_ops = std::uint64_t{0U};
+      for (auto const way : sampled_ways) {
+        auto const n =
+            static_cast<std::uint16_t>(w.r_->way_nodes_[way].size());
+        for (auto i = std::uint16_t{1U}; i < n; ++i) {
+          checksum += w.way_node_polyline(way, i - 1U, i).size();
+          ++n_ops;
+        }
+      }
+      return n_ops;
+    });
+  }
+  b.run("ways/way_node_polyline/append", [&](std::uint64_t& checksum) {
+    auto n_ops = std::uint64_t{0U};
+    auto polyline = geo::polyline{};
+    for (auto const way : sampled_ways) {
+      auto const n = static_cast<std::uint16_t>(w.r_->way_nodes_[way].size());
+      for (auto i = std::uint16_t{1U}; i < n; ++i) {
+        polyline.clear();
+        w.way_node_polyline(way, i - 1U, i, polyline);
+        checksum += polyline.size();
+        ++n_ops;
+      }
+    }
+    return n_ops;
+  });
+
+  // Full way geometry + OSM node ids as read by lookup::match.
+  if (!w.is_packed()) {
+    b.run("ways/decode/raw", [&](std::uint64_t& checksum) {
+      for (auto const way : sampled_ways) {
+        for (auto const p : w.way_polylines_[way]) {
+          checksum += static_cast<std::uint32_t>(p.lat_ ^ p.lng_);
+        }
+        for (auto const n : w.way_osm_nodes_[way]) {
+          checksum += to_idx(n);
+        }
+      }
+      return sampled_ways.size();
+    });
+  } else {
+    b.run("ways/decode/packed", [&](std::uint64_t& checksum) {
+      auto polyline = std::vector<point>{};
+      auto osm_nodes = std::vector<osm_node_idx_t>{};
+      for (auto const way : sampled_ways) {
+        unpack_polyline(w.way_polyline_packed(way), polyline);
+        unpack_osm_nodes(w.way_osm_nodes_packed(way), osm_nodes);
+        for (auto const p : polyline) {
+          checksum += static_cast<std::uint32_t>(p.lat_ ^ p.lng_);
+        }
+        for (auto const n : osm_nodes) {
+          checksum += to_idx(n);
+        }
+      }
+      return sampled_ways.size();
+    });
+  }
+
+  // Path reconstruction (incl. add_path) as reported by the search stats
+  // (nanoseconds, most reconstructions take less than a microsecond).
+  b.measure("route/reconstruct/car", [&](std::uint64_t& checksum) {
+    auto reconstruct_time = search_stats::duration_t{};
+    auto n_found = std::uint64_t{0U};
+    for (auto i = 0U; i + 1U < std::min(locations.size(), std::size_t{200U});
+         i += 2U) {
+      auto const p = route(w, l, search_profile::kCar, locations[i],
+                           locations[i + 1U], 900U, direction::kForward, 100.0);
+      if (p.has_value()) {
+        checksum += p->cost_;
+        reconstruct_time += p->stats_.reconstruct_time_;
+        ++n_found;
+      }
+    }
+    return std::pair{n_found, reconstruct_time};
+  });
+
+  b.run("geojson_writer/write_way", [&](std::uint64_t& checksum) {
+    for (auto const way : sampled_ways) {
+      auto gj = geojson_writer{.w_ = w};
+      gj.write_way(way);
+      checksum += gj.features_.size();
+    }
+    return sampled_ways.size();
+  });
+}
@@ -0,0 +1,252 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "boost/asio/connect.hpp"
+#include "boost/asio/io_context.hpp"
+#include "boost/asio/ip/tcp.hpp"
+#include "boost/beast/core.hpp"
+#include "boost/beast/http.hpp"
+#include "boost/json.hpp"
+
+#include "fmt/core.h"
+#include "fmt/std.h"
+
+#include "conf/options_parser.h"
+
+#include "utl/verify.h"
+#include "utl/zip.h"
+
+namespace fs = std::filesystem;
+namespace http = boost::beast::http;
+using tcp = boost::asio::ip::tcp;
+
+class settings : public conf::configuration {
+public:
+  explicit settings() : configuration("Options") {
+    param(log_, "log,l", "Request log written by osr-backend --request_log");
+    param(host_, "host,h", "HTTP host");
+    param(port_, "port,p", "HTTP port");
+    param(connections_, "connections,c", "Number of parallel connections");
+    param(qps_, "qps,q",
+          "Fixed request rate (open loop), 0 = as fast as possible");
+    param(speedup_, "speedup,s",
+          "Replay with the logged timing sped up by this factor (open loop), "
+          "0 = ignore timestamps");
+    param(n_requests_, "requests,n", "Stop after n requests (0 = all)");
+  }
+
+  fs::path log_{"requests.jsonl"};
+  std::string host_{"127.0.0.1"};
+  std::string port_{"8000"};
+  unsigned connections_{8U};
+  double qps_{0.0};
+  double speedup_{0.0};
+  std::size_t n_requests_{0U};
+};
+
+struct logged_request {
+  std::int64_t time_us_;
+  std::string target_;
+  std::string body_;
+};
+
+struct result {
+  std::chrono::microseconds latency_{};
+  unsigned status_{0U};  // 0 = connection error
+};
+
+std::vector<logged_request> read_log(fs::path const& p, std::size_t const n) {
+  auto in = std::ifstream{p};
+  utl::verify(in.good(), "could not open {}", p);
+  auto requests = std::vector<logged_request>{};
+  auto line = std::string{};
+  while ((n == 0U || requests.size() < n) && std::getline(in, line)) {
+    if (line.empty()) {
+      continue;
+    }
+    auto const json = boost::json::parse(line).as_object();
+    requests.push_back(
+        {.time_us_ = json.at("time_us").to_number<std::int64_t>(),
+         .target_ = std::string{json.at("target").as_string()},
+         .body_ = std::string{json.at("body").as_string()}});
+  }
+  return requests;
+}
+
+// Keep-alive connection, reconnects after errors and "Connection: close".
+struct connection {
+  connection(std::string const& host, std::string const& port)
+      : host_{host}, endpoints_{tcp::resolver{ioc_}.resolve(host, port)} {}
+
+  unsigned send(logged_request const& r) {
+    try {
+      if (!stream_.has_value()) {
+        stream_.emplace(ioc_);
+        stream_->connect(endpoints_);
+      }
+
+      auto req = http::request<http::string_body>{http::verb::post,
+                                                  r.target_, 11};
+      req.set(http::field::host, host_);
+      req.set(http::field::content_type, "application/json");
+      req.keep_alive(true);
+      req.body() = r.body_;
+      req.prepare_payload();
+      http::write(*stream_, req);
+
+      auto buf = boost::beast::flat_buffer{};
+      auto res = http::response<http::string_body>{};
+      http::read(*stream_, buf, res);
+      if (!res.keep_alive()) {
+        stream_.reset();
+      }
+      return res.result_int();
+    } catch (std::exception const&) {
+      stream_.reset();
+      return 0U;
+    }
+  }
+
+  boost::asio::io_context ioc_;
+  std::string host_;
+  tcp::resolver::results_type endpoints_;
+  std::optional<boost::beast::tcp_stream> stream_;
+};
+
+double quantile(std::vector<std::chrono::microseconds> const& sorted,
+                double const q) {
+  if (sorted.empty()) {
+    return 0.0;
+  }
+  auto const i = std::min(sorted.size() - 1U,
+                          static_cast<std::size_t>(sorted.size() * q));
+  return static_cast<double>(sorted[i].count()) / 1000.0;
+}
+
+void print_report(std::string_view name,
+                  std::vector<result const*> const& results,
+                  std::chrono::duration<double> const duration) {
+  auto latencies = std::vector<std::chrono::microseconds>{};
+  auto status = std::map<unsigned, std::size_t>{};
+  for (auto const* r : results) {
+    latencies.push_back(r->latency_);
+    ++status[r->status_];
+  }
+  std::ranges::sort(latencies);
+
+  auto const n_ok = std::ranges::count_if(results, [](result const* r) {
+    return r->status_ >= 200U && r->status_ < 300U;
+  });
+  fmt::println(
+      "\n--- {} --- (n = {}, {:.1f} req/s, errors = {:.2f}%)", name,
+      results.size(), results.size() / duration.count(),
+      results.empty()
+          ? 0.0
+          : 100.0 * static_cast<double>(results.size() - n_ok) /
+                static_cast<double>(results.size()));
+  fmt::println("  latency ms: p50 {:.2f}  p90 {:.2f}  p99 {:.2f}  "
+               "p99.9 {:.2f}  max {:.2f}",
+               quantile(latencies, 0.5), quantile(latencies, 0.9),
+               quantile(latencies, 0.99), quantile(latencies, 0.999),
+               quantile(latencies, 1.0));
+  for (auto const [code, count] : status) {
+    if (code == 0U) {
+      fmt::println("  connection error: {}", count);
+    } else {
+      fmt::println("  HTTP {}: {}", code, count);
+    }
+  }
+}
+
+int main(int argc, char const* argv[]) {
+  auto opt = settings{};
+  auto parser = conf::options_parser({&opt});
+  parser.read_command_line_args(argc, argv);
+
+  if (parser.help()) {
+    parser.print_help(std::cout);
+    return 0;
+  } else if (parser.version()) {
+    return 0;
+  }
+
+  parser.read_configuration_file();
+  parser.print_unrecognized(std::cout);
+  parser.print_used(std::cout);
+
+  auto const requests = read_log(opt.log_, opt.n_requests_);
+  if (requests.empty()) {
+    fmt::println("no requests in {}", opt.log_);
+    return 1;
+  }
+
+  // Open loop: request i is due at a fixed point in time, its latency
+  // includes the time it waited for a free connection.
+  using clock = std::chrono::steady_clock;
+  auto const open_loop = opt.qps_ > 0.0 || opt.speedup_ > 0.0;
+  auto const start = clock::now() + std::chrono::milliseconds{100};
+  auto const get_due = [&](std::size_t const i) -> clock::time_point {
+    if (opt.qps_ > 0.0) {
+      return start + std::chrono::duration_cast<clock::duration>(
+                         std::chrono::duration<double>{i / opt.qps_});
+    } else if (opt.speedup_ > 0.0) {
+      return start +
+             std::chrono::duration_cast<clock::duration>(
+                 std::chrono::duration<double, std::micro>{
+                     (requests[i].time_us_ - requests.front().time_us_) /
+                     opt.speedup_});
+    }
+    return start;
+  };
+
+  auto results = std::vector<result>(requests.size());
+  auto next = std::atomic_size_t{0U};
+  auto threads = std::vector<std::thread>(std::max(1U, opt.connections_));
+  for (auto& t : threads) {
+    t = std::thread([&]() {
+      auto c = connection{opt.host_, opt.port_};
+      for (auto i = next.fetch_add(1U); i < requests.size();
+           i = next.fetch_add(1U)) {
+        auto const due = get_due(i);
+        std::this_thread::sleep_until(due);
+        auto const sent = clock::now();
+        results[i].status_ = c.send(requests[i]);
+        results[i].latency_ =
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                clock::now() - (open_loop ? due : sent));
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  auto const duration = std::chrono::duration<double>{clock::now() - start};
+
+  auto all = std::vector<result const*>{};
+  auto by_target = std::map<std::string, std::vector<result const*>>{};
+  for (auto const [r, req] : utl::zip(results, requests)) {
+    all.push_back(&r);
+    auto const& t = req.target_;
+    by_target[t.substr(0U, t.find('?'))].push_back(&r);
+  }
+
+  print_report("all", all, duration);
+  for (auto const& [target, x] : by_target) {
+    print_report(target, x, duration);
+  }
+
+  return std::ranges::all_of(
+             results, [](result const& r) { return r.status_ != 0U; })
+             ? 0
+             : 1;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace osr {
+
+// Completed extract() phases, in order.
+enum class extract_phase : std::uint8_t {
+  kNone,
+  kWays,  // coordinates + ways (the node index is not persisted)
+  kConnectWays,
+  kNodeProperties,
+  kRestrictions,
+  kRtree  // done
+};
+
+std::string_view to_str(extract_phase);
+
+// Manifest written to the output directory after every completed phase.
+// Only valid for the same input file and output affecting options. Files
+// are truncated to the recorded size on resume: memory mapped files are
+// larger than their content until they are closed.
+struct checkpoint {
+  std::uint64_t input_hash_{0U};
+  std::uint64_t options_hash_{0U};
+  extract_phase phase_{extract_phase::kNone};
+  std::vector<std::pair<std::string, std::uint64_t>> files_;
+};
+
+std::uint64_t hash_file(std::filesystem::path const&);
+
+std::optional<checkpoint> read_checkpoint(std::filesystem::path const& dir);
+
+// Records sizes of all files in dir (except temporary "tmp_*" files),
+// replaces the manifest atomically.
+void write_checkpoint(std::filesystem::path const& dir, checkpoint&);
+
+// Truncates files to their recorded size.
+void restore_checkpoint(std::filesystem::path const& dir, checkpoint const&);
+
+}  // namespace osr
@@ -1,9 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
+#include <optional>
+#include <string_view>
+
+#include "geo/box.h"
+
+#include "osr/extract/checkpoint.h"
 
 namespace osr {
 
+// Storage for node coordinates while resolving way geometries.
+// kAuto picks based on input file size and available memory.
+enum class node_index_type : std::uint8_t {
+  kAuto,
+  kDenseMem,  // flat array indexed by node id, fastest, ~2^34 * 8 bytes
+  kSparseMem,  // sorted (id, location) pairs, ~16 bytes per node
+  kHybridFile  // tiles::hybrid_node_idx on disk, lowest memory usage
+};
+
+node_index_type parse_node_index_type(std::string_view);
+std::string_view to_str(node_index_type);
+
+struct extract_options {
+  bool with_platforms_{false};
+
+  // Clipping: only ways with at least one node inside the bounding box or
+  // polygon (osmosis .poly file) are extracted. At most one of both.
+  std::optional<geo::box> bbox_;
+  std::filesystem::path poly_;
+
+  // Available RAM in bytes (best-effort hint, not a limit), 0 = unknown.
+  // If set, staged node data goes to temporary files in the output
+  // directory, fewer input buffers are processed in parallel and the node
+  // index is chosen for it. Other intermediates (relation ways, elevator
+  // nodes, strings) and the routing data stay in memory.
+  std::size_t memory_hint_{0U};
+
+  node_index_type node_index_{node_index_type::kAuto};
+
+  // Store way geometries and OSM node ids delta varint coded instead of
+  // raw (ways::pack_geometry): less disk space, decoded on access.
+  bool pack_geometry_{false};
+
+  // Write a checkpoint after every phase and continue after the last
+  // completed phase if the output directory has one for the same input.
+  bool checkpoint_{false};
+
+  // Stop after this phase, continue with a later call (needs checkpoint_).
+  extract_phase stop_after_{extract_phase::kRtree};
+};
+
+void extract(extract_options const&,
+             std::filesystem::path const& in,
+             std::filesystem::path const& out);
+
 void extract(bool with_platforms,
              std::filesystem::path const& in,
              std::filesystem::path const& out);
 
-}  // namespace osr
\ No newline at end of file
+}  // namespace osr
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace osr {
+
+struct phase_profile {
+  double objects_per_second() const {
+    return wall_time_ == 0.0 ? 0.0
+                             : static_cast<double>(n_objects_) / wall_time_;
+  }
+
+  std::string name_;
+  double wall_time_{0.0};  // seconds
+  double cpu_time_{0.0};  // seconds, user + system of all threads
+  std::uint64_t peak_rss_{0U};  // bytes
+  std::uint64_t bytes_read_{0U};  // storage I/O
+  std::uint64_t bytes_written_{0U};
+  std::uint64_t n_objects_{0U};  // main output or input of the phase
+};
+
+// Resource usage of consecutive extract() phases: a phase starts where
+// the previous one finished. Peak RSS is per phase where the OS allows
+// resetting it (Linux), otherwise the process peak so far. I/O counters
+// are only available on Linux and Windows.
+struct extract_profile {
+  struct usage {
+    static usage now();
+
+    std::chrono::steady_clock::time_point wall_time_;
+    double cpu_time_{0.0};
+    std::uint64_t bytes_read_{0U};
+    std::uint64_t bytes_written_{0U};
+  };
+
+  extract_profile();
+
+  void finish(std::string_view phase, std::uint64_t n_objects);
+
+  void print() const;
+  void write_json(std::filesystem::path const&) const;
+
+  std::vector<phase_profile> phases_;
+  usage start_;
+};
+
+}  // namespace osr
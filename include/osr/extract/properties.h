@@ -0,0 +1,14 @@
+#pragma once
+
+#include <utility>
+
+#include "osr/extract/tags.h"
+#include "osr/ways.h"
+
+namespace osr {
+
+way_properties get_way_properties(tags const&);
+
+std::pair<node_properties, level_bits_t> get_node_properties(tags const&);
+
+}  // namespace osr
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <filesystem>
+#include <string_view>
+#include <vector>
+
+#include "geo/box.h"
+#include "geo/latlng.h"
+
+namespace osr {
+
+// Area to extract: a bounding box, optionally refined by polygons with
+// holes (osmosis .poly format).
+struct region {
+  bool contains(geo::latlng const&) const;
+
+  geo::box bbox_;
+  std::vector<std::vector<geo::latlng>> outer_, inner_;
+};
+
+// "min_lng,min_lat,max_lng,max_lat" (same order as osmium extract)
+geo::box parse_bbox(std::string_view);
+
+region parse_poly(std::string_view);
+
+region read_poly(std::filesystem::path const&);
+
+}  // namespace osr
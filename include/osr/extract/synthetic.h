@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cinttypes>
+#include <filesystem>
+
+namespace osr {
+
+// Parameterised grid road network. Every parameter change yields a
+// different but deterministic network (same options = same file).
+struct synthetic_options {
+  std::uint32_t n_rows_{100U};
+  std::uint32_t n_cols_{100U};
+  double spacing_{100.0};  // meters between neighbouring intersections
+  double origin_lat_{48.0};
+  double origin_lng_{9.0};
+
+  double delete_probability_{0.05};  // per grid segment
+  double oneway_probability_{0.1};  // per residential way
+  std::uint32_t secondary_every_{5U};  // every n-th row/column
+  std::uint32_t primary_every_{25U};
+
+  std::uint32_t n_buildings_{0U};
+  std::uint32_t n_levels_{4U};  // 1-4, connected by elevator + steps
+  std::uint32_t n_restrictions_{0U};
+  double platform_probability_{0.0};  // per intersection
+
+  std::uint64_t seed_{0U};
+};
+
+// Writes the network as OSM file (format from the file extension).
+void write_synthetic_osm(synthetic_options const&,
+                         std::filesystem::path const&);
+
+}  // namespace osr
@@ -13,6 +13,8 @@ enum class osm_obj_type : std::uint8_t { kWay, kNode };
 enum class override : std::uint8_t { kNone, kWhitelist, kBlacklist };
 
 struct tags {
+  tags() = default;
+
   explicit tags(osmium::OSMObject const& o) {
     auto const add_levels = [](auto&& t, level_bits_t& level_bits) {
       auto s = utl::cstr{t.value()};
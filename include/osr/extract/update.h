@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+
+namespace osr {
+
+struct update_stats {
+  bool requires_full_extract() const {
+    return n_new_ways_ != 0U || n_topology_changes_ != 0U ||
+           n_relation_changes_ != 0U || n_node_changes_ != 0U;
+  }
+
+  // Applied.
+  std::size_t n_way_properties_{0U};
+  std::size_t n_deleted_ways_{0U};
+  std::size_t n_node_properties_{0U};
+  std::size_t n_moved_nodes_{0U};
+  std::size_t n_geometries_{0U};
+
+  // Not supported incrementally, nothing is written if any of these is set.
+  std::size_t n_new_ways_{0U};  // routable way without way index
+  std::size_t n_topology_changes_{0U};  // changed way node list
+  std::size_t n_relation_changes_{0U};  // restriction or routable relation
+  std::size_t n_node_changes_{0U};  // elevators, new barriers
+};
+
+// Applies an OSM change file (.osc / .osc.gz) to a data directory written
+// by extract(). Supported: changed way/node tags, deleted ways (tombstoned:
+// inaccessible + removed from the rtree) and moved nodes. Changes that
+// alter the graph topology are only counted, in that case the data
+// directory is left untouched and a full extract is required.
+update_stats update(std::filesystem::path const& osc,
+                    std::filesystem::path const& data);
+
+}  // namespace osr
@@ -56,7 +56,7 @@ struct geojson_writer {
                             return to_point(platforms_->get_node_pos(x));
                           },
                           [&](way_idx_t x) {
-                            return to_line_string(w_.way_polylines_[x]);
+                            return to_line_string(w_.way_polyline(x));
                           }},
           to_ref(r));
       features_.emplace_back(boost::json::value{
@@ -120,7 +120,7 @@ struct geojson_writer {
                              {"to_level", p.to_level().to_float()},
                              {"is_elevator", p.is_elevator()},
                              {"is_steps", p.is_steps()}}},
-                           {"geometry", to_line_string(w_.way_polylines_[i])}});
+                           {"geometry", to_line_string(w_.way_polyline(i))}});
 
     nodes_.insert(begin(nodes), end(nodes));
   }
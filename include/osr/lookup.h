@@ -16,6 +16,7 @@
 
 #include "osr/location.h"
 #include "osr/routing/profile.h"
+#include "osr/util/delta_varint.h"
 
 namespace osr {
 
@@ -73,6 +74,13 @@ struct lookup {
 
   void build_rtree();
 
+  // Incremental rtree updates, require cista::mmap::protection::MODIFY.
+  // remove_way() needs the bounding box the way was inserted with.
+  geo::box get_way_bbox(way_idx_t) const;
+  void insert_way(way_idx_t);
+  void remove_way(way_idx_t, geo::box const&);
+  void write_rtree_meta();
+
   cista::mmap mm(char const* file) {
     return cista::mmap{(p_ / file).generic_string().c_str(), mode_};
   }
@@ -123,27 +131,49 @@ private:
                              double const max_match_distance,
                              bitvec<node_idx_t> const* blocked) const {
     auto way_candidates = std::vector<way_candidate>{};
-    find(geo::box{query.pos_, max_match_distance}, [&](way_idx_t const way) {
-      auto d = geo::distance_to_polyline<way_candidate>(
-          query.pos_, ways_.way_polylines_[way]);
+    auto const match_way = [&](way_idx_t const way, auto const& polyline,
+                               auto&& get_osm_nodes) {
+      auto d = geo::distance_to_polyline<way_candidate>(query.pos_, polyline);
       if (d.dist_to_way_ < max_match_distance) {
+        auto const& osm_nodes = get_osm_nodes();
         auto& wc = way_candidates.emplace_back(std::move(d));
         wc.query_ = query;
         wc.way_ = way;
-        wc.left_ =
-            find_next_node<Profile>(wc, query, direction::kBackward, query.lvl_,
-                                    reverse, search_dir, blocked);
-        wc.right_ =
-            find_next_node<Profile>(wc, query, direction::kForward, query.lvl_,
-                                    reverse, search_dir, blocked);
+        wc.left_ = find_next_node<Profile>(
+            wc, polyline, osm_nodes, query, direction::kBackward, query.lvl_,
+            reverse, search_dir, blocked);
+        wc.right_ = find_next_node<Profile>(
+            wc, polyline, osm_nodes, query, direction::kForward, query.lvl_,
+            reverse, search_dir, blocked);
+      }
+    };
+
+    // Packed: decode into buffers reused for all ways, OSM node ids only
+    // for ways within the match distance.
+    auto polyline = std::vector<point>{};
+    auto osm_nodes = std::vector<osm_node_idx_t>{};
+    find(geo::box{query.pos_, max_match_distance}, [&](way_idx_t const way) {
+      if (ways_.is_packed()) {
+        unpack_polyline(ways_.way_polyline_packed(way), polyline);
+        match_way(way, polyline,
+                  [&]() -> std::vector<osm_node_idx_t> const& {
+                    unpack_osm_nodes(ways_.way_osm_nodes_packed(way),
+                                     osm_nodes);
+                    return osm_nodes;
+                  });
+      } else {
+        match_way(way, ways_.way_polylines_[way],
+                  [&]() { return ways_.way_osm_nodes_[way]; });
       }
     });
     utl::sort(way_candidates);
     return way_candidates;
   }
 
-  template <typename Profile>
+  template <typename Profile, typename Polyline, typename OsmNodes>
   node_candidate find_next_node(way_candidate const& wc,
+                                Polyline const& polyline,
+                                OsmNodes const& osm_nodes,
                                 location const& query,
                                 direction const dir,
                                 level_t const lvl,
@@ -165,9 +195,6 @@ private:
                             .cost_ = offroad_cost,
                             .offroad_cost_ = offroad_cost,
                             .path_ = {query.pos_, wc.best_}};
-    auto const polyline = ways_.way_polylines_[wc.way_];
-    auto const osm_nodes = ways_.way_osm_nodes_[wc.way_];
-
     till_the_end(wc.segment_idx_ + (dir == direction::kForward ? 1U : 0U),
                  utl::zip(polyline, osm_nodes), dir, [&](auto&& x) {
                    auto const& [pos, osm_node_idx] = x;
@@ -197,9 +197,9 @@ struct platforms {
 
                 [&](way_idx_t const x) {
                   auto b = osmium::Box{};
-                  for (auto const& c : w.way_polylines_[x]) {
+                  w.for_each_polyline_point(x, [&](point const& c) {
                     b.extend(osmium::Location{c.lat_, c.lng_});
-                  }
+                  });
 
                   auto const min_corner =
                       std::array{b.bottom_left().lon(), b.bottom_left().lat()};
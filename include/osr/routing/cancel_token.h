@@ -0,0 +1,33 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+
+namespace osr {
+
+// Shared between the search and the party that wants to stop it.
+// The search polls is_cancelled() and throws search_cancelled.
+struct cancel_token {
+  using clock = std::chrono::steady_clock;
+
+  cancel_token() = default;
+  explicit cancel_token(clock::time_point const deadline)
+      : deadline_{deadline} {}
+
+  void cancel() noexcept { cancelled_.store(true, std::memory_order_relaxed); }
+
+  bool is_cancelled() const noexcept {
+    return cancelled_.load(std::memory_order_relaxed) ||
+           clock::now() >= deadline_;
+  }
+
+  std::atomic_bool cancelled_{false};
+  clock::time_point deadline_{clock::time_point::max()};
+};
+
+struct search_cancelled : public std::runtime_error {
+  search_cancelled() : std::runtime_error{"search cancelled"} {}
+};
+
+}  // namespace osr
@@ -1,7 +1,10 @@
 #pragma once
 
 #include "osr/routing/additional_edge.h"
+#include "osr/routing/cancel_token.h"
 #include "osr/routing/dial.h"
+#include "osr/routing/pred_arc.h"
+#include "osr/routing/search_stats.h"
 #include "osr/types.h"
 #include "osr/ways.h"
 
@@ -11,6 +14,9 @@ struct sharing_data;
 
 constexpr auto const kDebug = false;
 
+// Number of settled labels between two checks of the cancel token.
+constexpr auto const kCancelCheckInterval = 1024U;
+
 template <typename Profile>
 struct dijkstra {
   using profile_t = Profile;
@@ -28,11 +34,12 @@ struct dijkstra {
     pq_.clear();
     pq_.n_buckets(max + 1U);
     cost_.clear();
+    stats_ = {};
   }
 
   void add_start(ways const& w, label const l) {
     if (cost_[l.get_node().get_key()].update(l, l.get_node(), l.cost(),
-                                             node::invalid())) {
+                                             node::invalid(), pred_arc{})) {
       if constexpr (kDebug) {
         std::cout << "START ";
         l.get_node().print(std::cout, w);
@@ -52,13 +59,32 @@ struct dijkstra {
            ways::routing const& r,
            cost_t const max,
            bitvec<node_idx_t> const* blocked,
-           sharing_data const* sharing) {
+           sharing_data const* sharing,
+           cancel_token const* cancel = nullptr) {
+    auto n_settled = 0U;
     while (!pq_.empty()) {
       auto l = pq_.pop();
+      if constexpr (kSearchStats) {
+        ++stats_.n_popped_;
+      }
+
       if (get_cost(l.get_node()) < l.cost()) {
+        if constexpr (kSearchStats) {
+          ++stats_.n_stale_;
+        }
         continue;
       }
 
+      if constexpr (kSearchStats) {
+        ++stats_.n_settled_;
+      }
+
+      if (cancel != nullptr && ++n_settled % kCancelCheckInterval == 0U &&
+          cancel->is_cancelled()) {
+        pq_.clear();
+        throw search_cancelled{};
+      }
+
       if constexpr (kDebug) {
         std::cout << "EXTRACT ";
         l.get_node().print(std::cout, w);
@@ -69,30 +95,57 @@ struct dijkstra {
       Profile::template adjacent<SearchDir, WithBlocked>(
           r, curr, blocked, sharing,
           [&](node const neighbor, std::uint32_t const cost, distance_t,
-              way_idx_t const way, std::uint16_t, std::uint16_t) {
+              way_idx_t const way, std::uint16_t const from,
+              std::uint16_t const to) {
             if constexpr (kDebug) {
               std::cout << "  NEIGHBOR ";
               neighbor.print(std::cout, w);
             }
 
             auto const total = l.cost() + cost;
-            if (total < max &&
-                cost_[neighbor.get_key()].update(
-                    l, neighbor, static_cast<cost_t>(total), curr)) {
+            if (total >= max) {
+              if constexpr (kSearchStats) {
+                ++stats_.n_max_cutoff_;
+              }
+
+              if constexpr (kDebug) {
+                std::cout << " -> MAX\n";
+              }
+              return;
+            }
+
+            if (cost_[neighbor.get_key()].update(
+                    l, neighbor, static_cast<cost_t>(total), curr,
+                    pred_arc{way, from, to})) {
               auto next = label{neighbor, static_cast<cost_t>(total)};
               next.track(l, r, way, neighbor.get_node());
               pq_.push(std::move(next));
 
+              if constexpr (kSearchStats) {
+                ++stats_.n_pushed_;
+                stats_.max_queue_size_ =
+                    std::max(stats_.max_queue_size_,
+                             static_cast<std::uint64_t>(pq_.size()));
+              }
+
               if constexpr (kDebug) {
                 std::cout << " -> PUSH\n";
               }
             } else {
+              if constexpr (kSearchStats) {
+                ++stats_.n_dominated_;
+              }
+
               if constexpr (kDebug) {
                 std::cout << " -> DOMINATED\n";
               }
             }
           });
     }
+
+    if constexpr (kSearchStats) {
+      stats_.n_entries_ = cost_.size();
+    }
   }
 
   void run(ways const& w,
@@ -100,20 +153,24 @@ struct dijkstra {
            cost_t const max,
            bitvec<node_idx_t> const* blocked,
            sharing_data const* sharing,
-           direction const dir) {
+           direction const dir,
+           cancel_token const* cancel = nullptr) {
     if (blocked == nullptr) {
       dir == direction::kForward
-          ? run<direction::kForward, false>(w, r, max, blocked, sharing)
-          : run<direction::kBackward, false>(w, r, max, blocked, sharing);
+          ? run<direction::kForward, false>(w, r, max, blocked, sharing, cancel)
+          : run<direction::kBackward, false>(w, r, max, blocked, sharing,
+                                             cancel);
     } else {
       dir == direction::kForward
-          ? run<direction::kForward, true>(w, r, max, blocked, sharing)
-          : run<direction::kBackward, true>(w, r, max, blocked, sharing);
+          ? run<direction::kForward, true>(w, r, max, blocked, sharing, cancel)
+          : run<direction::kBackward, true>(w, r, max, blocked, sharing,
+                                            cancel);
     }
   }
 
   dial<label, get_bucket> pq_{get_bucket{}};
   ankerl::unordered_dense::map<key, entry, hash> cost_;
+  search_stats stats_;
 };
 
 }  // namespace osr
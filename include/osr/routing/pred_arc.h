@@ -0,0 +1,45 @@
+#pragma once
+
+#include <array>
+#include <cinttypes>
+#include <optional>
+
+#include "osr/types.h"
+
+namespace osr {
+
+#if defined(OSR_PRED_ARCS)
+constexpr auto const kStorePredArcs = true;
+#else
+constexpr auto const kStorePredArcs = false;
+#endif
+
+// Edge that was used to reach a node: way + index of predecessor and node.
+struct pred_arc {
+  way_idx_t way_{way_idx_t::invalid()};
+  std::uint16_t from_{}, to_{};
+};
+
+// Per-entry storage for the predecessor arcs of N labels.
+// Empty (no storage, always std::nullopt) if not enabled.
+template <bool Enabled, std::size_t N>
+struct pred_arcs {
+  constexpr void set(std::size_t, pred_arc const&) noexcept {}
+  constexpr std::optional<pred_arc> get(std::size_t) const noexcept {
+    return std::nullopt;
+  }
+};
+
+template <std::size_t N>
+struct pred_arcs<true, N> {
+  constexpr void set(std::size_t const i, pred_arc const& a) noexcept {
+    arcs_[i] = a;
+  }
+  constexpr std::optional<pred_arc> get(std::size_t const i) const noexcept {
+    return arcs_[i];
+  }
+
+  std::array<pred_arc, N> arcs_{};
+};
+
+}  // namespace osr
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "osr/routing/mode.h"
+#include "osr/routing/pred_arc.h"
 #include "osr/routing/route.h"
 #include "osr/ways.h"
 
@@ -64,7 +65,8 @@ struct bike {
     constexpr bool update(label const&,
                           node,
                           cost_t const c,
-                          node const pred) noexcept {
+                          node const pred,
+                          pred_arc const&) noexcept {
       if (c < cost_) {
         cost_ = c;
         pred_ = pred.n_;
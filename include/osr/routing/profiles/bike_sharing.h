@@ -11,6 +11,7 @@
 
 #include "osr/routing/additional_edge.h"
 #include "osr/routing/mode.h"
+#include "osr/routing/pred_arc.h"
 #include "osr/routing/profiles/bike.h"
 #include "osr/routing/profiles/foot.h"
 #include "osr/routing/route.h"
@@ -189,7 +190,8 @@ struct bike_sharing {
     constexpr bool update(label const,
                           node const n,
                           cost_t const c,
-                          node const pred) noexcept {
+                          node const pred,
+                          pred_arc const&) noexcept {
       auto const idx = get_index(n);
       if (c < cost_[idx]) {
         cost_[idx] = c;
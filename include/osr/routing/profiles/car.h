@@ -7,6 +7,7 @@
 #include "utl/helpers/algorithm.h"
 
 #include "osr/routing/mode.h"
+#include "osr/routing/pred_arc.h"
 #include "osr/routing/route.h"
 #include "osr/ways.h"
 
@@ -82,16 +83,22 @@ struct car {
       return cost_[get_index(n)];
     }
 
+    constexpr std::optional<pred_arc> arc(node const n) const noexcept {
+      return arcs_.get(get_index(n));
+    }
+
     constexpr bool update(label const&,
                           node const n,
                           cost_t const c,
-                          node const pred) noexcept {
+                          node const pred,
+                          pred_arc const& a) noexcept {
       auto const idx = get_index(n);
       if (c < cost_[idx]) {
         cost_[idx] = c;
         pred_[idx] = pred.n_;
         pred_way_[idx] = pred.way_;
         pred_dir_[idx] = to_bool(pred.dir_);
+        arcs_.set(idx, a);
         return true;
       }
       return false;
@@ -121,6 +128,7 @@ struct car {
     std::array<way_pos_t, kN> pred_way_;
     std::bitset<kN> pred_dir_;
     std::array<cost_t, kN> cost_;
+    [[no_unique_address]] pred_arcs<kStorePredArcs, kN> arcs_;
   };
 
   struct hash {
@@ -7,6 +7,7 @@
 #include "utl/helpers/algorithm.h"
 
 #include "osr/routing/mode.h"
+#include "osr/routing/pred_arc.h"
 #include "osr/routing/profiles/car.h"
 #include "osr/routing/profiles/foot.h"
 #include "osr/routing/route.h"
@@ -138,10 +139,15 @@ struct car_parking {
       return cost_[get_index(n)];
     }
 
+    constexpr std::optional<pred_arc> arc(node const n) const noexcept {
+      return arcs_.get(get_index(n));
+    }
+
     constexpr bool update(label const,
                           node const n,
                           cost_t const c,
-                          node const pred) noexcept {
+                          node const pred,
+                          pred_arc const& a) noexcept {
       auto const idx = get_index(n);
       if (c < cost_[idx]) {
         cost_[idx] = c;
@@ -150,6 +156,7 @@ struct car_parking {
         pred_type_[idx] = to_bool(pred.type_);
         pred_way_[idx] = pred.way_;
         pred_dir_[idx] = to_bool(pred.dir_);
+        arcs_.set(idx, a);
         return true;
       }
       return false;
@@ -187,6 +194,7 @@ struct car_parking {
     std::bitset<kN> pred_dir_;
     std::bitset<kN> pred_type_;
     std::bitset<kN> pred_parking_;
+    [[no_unique_address]] pred_arcs<kStorePredArcs, kN> arcs_;
   };
 
   struct hash {
@@ -3,6 +3,7 @@
 #include "utl/for_each_bit_set.h"
 
 #include "osr/routing/mode.h"
+#include "osr/routing/pred_arc.h"
 #include "osr/routing/tracking.h"
 #include "osr/ways.h"
 
@@ -72,7 +73,8 @@ struct foot {
     constexpr bool update(label const& l,
                           node,
                           cost_t const c,
-                          node const pred) noexcept {
+                          node const pred,
+                          pred_arc const&) noexcept {
       if (c < cost_) {
         tracking_ = l.tracking_;
         cost_ = c;
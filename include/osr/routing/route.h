@@ -9,6 +9,7 @@
 #include "osr/lookup.h"
 #include "osr/routing/mode.h"
 #include "osr/routing/profile.h"
+#include "osr/routing/search_stats.h"
 #include "osr/types.h"
 
 namespace osr {
@@ -20,6 +21,8 @@ struct dijkstra;
 
 struct sharing_data;
 
+struct cancel_token;
+
 struct path {
   struct segment {
     geo::polyline polyline_;
@@ -37,6 +40,7 @@ struct path {
   double dist_{0.0};
   std::vector<segment> segments_{};
   bool uses_elevator_{false};
+  search_stats stats_{};
 };
 
 template <typename Profile>
@@ -55,7 +59,8 @@ std::vector<std::optional<path>> route(
     sharing_data const* sharing = nullptr,
     std::function<bool(path const&)> const& do_reconstruct = [](path const&) {
       return false;
-    });
+    },
+    cancel_token const* cancel = nullptr);
 
 std::optional<path> route(ways const&,
                           lookup const&,
@@ -66,7 +71,8 @@ std::optional<path> route(ways const&,
                           direction,
                           double max_match_distance,
                           bitvec<node_idx_t> const* blocked = nullptr,
-                          sharing_data const* sharing = nullptr);
+                          sharing_data const* sharing = nullptr,
+                          cancel_token const* cancel = nullptr);
 
 std::optional<path> route(ways const&,
                           search_profile,
@@ -77,7 +83,8 @@ std::optional<path> route(ways const&,
                           cost_t const max,
                           direction,
                           bitvec<node_idx_t> const* blocked = nullptr,
-                          sharing_data const* sharing = nullptr);
+                          sharing_data const* sharing = nullptr,
+                          cancel_token const* cancel = nullptr);
 
 std::vector<std::optional<path>> route(
     ways const&,
@@ -92,6 +99,7 @@ std::vector<std::optional<path>> route(
     sharing_data const* sharing = nullptr,
     std::function<bool(path const&)> const& do_reconstruct = [](path const&) {
       return false;
-    });
+    },
+    cancel_token const* cancel = nullptr);
 
 }  // namespace osr
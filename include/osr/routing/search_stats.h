@@ -0,0 +1,46 @@
+#pragma once
+
+#include <chrono>
+#include <cinttypes>
+
+namespace osr {
+
+#if defined(OSR_SEARCH_STATS)
+constexpr auto const kSearchStats = true;
+#else
+constexpr auto const kSearchStats = false;
+#endif
+
+// Work done and time spent for the search that produced a path.
+// The counters stay zero if search statistics are disabled at compile time.
+struct search_stats {
+  // Nanoseconds: a single reconstruction often takes less than 1us.
+  using duration_t = std::chrono::nanoseconds;
+
+  std::uint64_t n_popped_{0U};
+  std::uint64_t n_stale_{0U};  // popped, but already settled with lower cost
+  std::uint64_t n_settled_{0U};
+  std::uint64_t n_pushed_{0U};
+  std::uint64_t n_dominated_{0U};  // relaxations without improvement
+  std::uint64_t n_max_cutoff_{0U};  // relaxations beyond the cost limit
+  std::uint64_t max_queue_size_{0U};
+  std::uint64_t n_entries_{0U};  // size of the cost hash map
+
+  duration_t match_time_{};
+  duration_t search_time_{};
+  duration_t reconstruct_time_{};
+};
+
+using search_clock = std::chrono::steady_clock;
+
+inline search_stats::duration_t elapsed_since(
+    search_clock::time_point const start) {
+  return std::chrono::duration_cast<search_stats::duration_t>(
+      search_clock::now() - start);
+}
+
+inline std::int64_t to_us(search_stats::duration_t const d) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+}
+
+}  // namespace osr
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+
+#include "osr/point.h"
+#include "osr/types.h"
+
+namespace osr {
+
+// Zig-zag delta varint coding of way geometries and OSM node ids:
+// consecutive vertices are close and OSM node ids of a way are often
+// ascending, so most deltas take 1-2 bytes instead of 8 (raw point / id).
+//
+// Polyline: varint(n), zz(lat_0), zz(lng_0), zz(lat_i - lat_i-1), ...
+// OSM nodes: varint(n), zz(id_0), zz(id_i - id_i-1), ...
+
+constexpr std::uint64_t zigzag_encode(std::int64_t const x) {
+  return (static_cast<std::uint64_t>(x) << 1U) ^
+         static_cast<std::uint64_t>(x >> 63U);
+}
+
+constexpr std::int64_t zigzag_decode(std::uint64_t const x) {
+  return static_cast<std::int64_t>(x >> 1U) ^
+         -static_cast<std::int64_t>(x & 1U);
+}
+
+template <typename Vec>
+void append_varint(Vec& out, std::uint64_t x) {
+  while (x >= 0x80U) {
+    out.push_back(static_cast<std::uint8_t>(x | 0x80U));
+    x >>= 7U;
+  }
+  out.push_back(static_cast<std::uint8_t>(x));
+}
+
+// No bounds checks: only for data written by append_varint.
+inline std::uint64_t read_varint(std::uint8_t const*& p) {
+  auto x = std::uint64_t{*p++};
+  if (x < 0x80U) [[likely]] {
+    return x;
+  }
+  x &= 0x7FU;
+  for (auto shift = 7U;; shift += 7U) {
+    auto const b = std::uint64_t{*p++};
+    x |= (b & 0x7FU) << shift;
+    if (b < 0x80U) {
+      return x;
+    }
+  }
+}
+
+template <typename Polyline, typename Vec>
+void pack_polyline(Polyline const& polyline, Vec& out) {
+  append_varint(out, static_cast<std::uint64_t>(polyline.size()));
+  auto prev = point{0, 0};
+  for (auto const& p : polyline) {
+    append_varint(out, zigzag_encode(std::int64_t{p.lat_} - prev.lat_));
+    append_varint(out, zigzag_encode(std::int64_t{p.lng_} - prev.lng_));
+    prev = p;
+  }
+}
+
+template <typename OsmNodes, typename Vec>
+void pack_osm_nodes(OsmNodes const& nodes, Vec& out) {
+  append_varint(out, static_cast<std::uint64_t>(nodes.size()));
+  auto prev = std::int64_t{0};
+  for (auto const n : nodes) {
+    auto const x = static_cast<std::int64_t>(to_idx(n));
+    append_varint(out, zigzag_encode(x - prev));
+    prev = x;
+  }
+}
+
+inline std::size_t packed_size(std::span<std::uint8_t const> packed) {
+  auto p = packed.data();
+  return packed.empty() ? 0U : static_cast<std::size_t>(read_varint(p));
+}
+
+// Calls fn(point) for points [from, to], stops decoding after `to`.
+template <typename Fn>
+void unpack_polyline(std::span<std::uint8_t const> packed,
+                     std::size_t const from,
+                     std::size_t const to,
+                     Fn&& fn) {
+  if (packed.empty()) {
+    return;
+  }
+  auto p = packed.data();
+  auto const n = static_cast<std::size_t>(read_varint(p));
+  auto lat = std::int64_t{0};
+  auto lng = std::int64_t{0};
+  for (auto i = std::size_t{0U}; i != n && i <= to; ++i) {
+    lat += zigzag_decode(read_varint(p));
+    lng += zigzag_decode(read_varint(p));
+    if (i >= from) {
+      fn(point{.lat_ = static_cast<std::int32_t>(lat),
+               .lng_ = static_cast<std::int32_t>(lng)});
+    }
+  }
+}
+
+// Replaces the content of out (keeps its capacity for the next way).
+template <typename Vec>
+void unpack_polyline(std::span<std::uint8_t const> packed, Vec& out) {
+  out.clear();
+  unpack_polyline(packed, 0U, std::numeric_limits<std::size_t>::max(),
+                  [&](point const& x) { out.push_back(x); });
+}
+
+template <typename Vec>
+void unpack_osm_nodes(std::span<std::uint8_t const> packed, Vec& out) {
+  out.clear();
+  if (packed.empty()) {
+    return;
+  }
+  auto p = packed.data();
+  auto const n = static_cast<std::size_t>(read_varint(p));
+  auto x = std::int64_t{0};
+  for (auto i = std::size_t{0U}; i != n; ++i) {
+    x += zigzag_decode(read_varint(p));
+    out.push_back(osm_node_idx_t{static_cast<std::uint64_t>(x)});
+  }
+}
+
+}  // namespace osr
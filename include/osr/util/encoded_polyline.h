@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cinttypes>
+#include <cmath>
+#include <string>
+
+#include "geo/polyline.h"
+
+#include "utl/verify.h"
+
+namespace osr {
+
+// Google encoded polyline algorithm format:
+// https://developers.google.com/maps/documentation/utilities/polylinealgorithm
+inline void encode_polyline_value(std::string& out, std::int64_t const v) {
+  auto x = static_cast<std::uint64_t>(v < 0 ? ~(v << 1) : (v << 1));
+  while (x >= 0x20U) {
+    out.push_back(static_cast<char>((0x20U | (x & 0x1FU)) + 63U));
+    x >>= 5U;
+  }
+  out.push_back(static_cast<char>(x + 63U));
+}
+
+// Decimal places: 5 (Google) or 6 (OSRM / Valhalla "polyline6").
+constexpr bool is_valid_polyline_precision(std::int64_t const precision) {
+  return precision == 5 || precision == 6;
+}
+
+inline void encode_polyline(std::string& out,
+                            geo::polyline const& polyline,
+                            unsigned const precision = 5U) {
+  utl::verify(is_valid_polyline_precision(precision),
+              "unsupported polyline precision {}", precision);
+  auto const factor = precision == 5U ? 1E5 : 1E6;
+  auto prev_lat = std::int64_t{0};
+  auto prev_lng = std::int64_t{0};
+  for (auto const& p : polyline) {
+    auto const lat = static_cast<std::int64_t>(std::round(p.lat_ * factor));
+    auto const lng = static_cast<std::int64_t>(std::round(p.lng_ * factor));
+    encode_polyline_value(out, lat - prev_lat);
+    encode_polyline_value(out, lng - prev_lng);
+    prev_lat = lat;
+    prev_lng = lng;
+  }
+}
+
+inline std::string encode_polyline(geo::polyline const& polyline,
+                                   unsigned const precision = 5U) {
+  auto out = std::string{};
+  encode_polyline(out, polyline, precision);
+  return out;
+}
+
+}  // namespace osr
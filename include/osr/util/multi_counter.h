@@ -1,36 +1,187 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <bit>
 #include <cinttypes>
+#include <memory>
 
-#include "osr/types.h"
+#include "utl/verify.h"
 
 namespace osr {
 
+// Remembers which ids have been counted at least once / more than once.
+//
+// Two-level radix directory over blocks of 2^16 ids. Directory chunks and
+// bitmap pages are allocated on first use, so memory is proportional to
+// the number of distinct id blocks referenced, not to the maximum id.
+// increment() is lock-free and may be called concurrently.
 struct multi_counter {
-  using size_type = bitvec64::size_type;
+  using size_type = std::uint64_t;
 
-  bool is_multi(size_type const i) const { return multi_[i]; }
+  static constexpr auto const kPageBits = 16U;
+  static constexpr auto const kChunkBits = 12U;
+  static constexpr auto const kTopBits = 12U;
+  static constexpr auto const kMaxId = size_type{1U}
+                                       << (kPageBits + kChunkBits + kTopBits);
+
+  struct page {
+    static constexpr auto const kWords = (1U << kPageBits) / 64U;
+    std::array<std::uint64_t, kWords> once_{};
+    std::array<std::uint64_t, kWords> multi_{};
+  };
+
+  using chunk = std::array<std::atomic<page*>, 1U << kChunkBits>;
+  using directory = std::array<std::atomic<chunk*>, 1U << kTopBits>;
+
+  multi_counter() : dir_{std::make_unique<directory>()} {}
+
+  multi_counter(multi_counter&& o) noexcept
+      : dir_{std::move(o.dir_)},
+        size_{o.size_.load()},
+        n_pages_{o.n_pages_.load()} {}
+
+  multi_counter& operator=(multi_counter&& o) noexcept {
+    if (this != &o) {
+      clear();
+      dir_ = std::move(o.dir_);
+      size_ = o.size_.load();
+      n_pages_ = o.n_pages_.load();
+    }
+    return *this;
+  }
+
+  ~multi_counter() { clear(); }
+
+  bool contains(size_type const i) const {
+    auto const* p = find_page(i);
+    return p != nullptr && (p->once_[word(i)] & bit(i)) != 0U;
+  }
+
+  bool is_multi(size_type const i) const {
+    auto const* p = find_page(i);
+    return p != nullptr && (p->multi_[word(i)] & bit(i)) != 0U;
+  }
 
   void increment(size_type const i) {
-    once_.resize(std::max(once_.size(), i + 1U));
-    multi_.resize(std::max(multi_.size(), i + 1U));
-    if (once_[i]) {
-      if (!multi_[i]) {
-        multi_.set(i, true);
+    utl::verify(i < kMaxId, "multi_counter: id {} out of range", i);
+    auto& p = get_page(i);
+    auto const was_set =
+        std::atomic_ref{p.once_[word(i)]}.fetch_or(bit(i)) & bit(i);
+    if (was_set) {
+      std::atomic_ref{p.multi_[word(i)]}.fetch_or(bit(i));
+    }
+
+    auto prev = size_.load(std::memory_order_relaxed);
+    while (prev < i + 1U && !size_.compare_exchange_weak(prev, i + 1U)) {
+    }
+  }
+
+  // Largest counted id + 1.
+  size_type size() const noexcept { return size_.load(); }
+
+  // Calls fn(id) for every id counted more than once, in ascending order.
+  // Not safe to run concurrently with increment().
+  template <typename Fn>
+  void for_each_multi(Fn&& fn) const {
+    for (auto c = size_type{0U}; c != dir_->size(); ++c) {
+      auto const* ch = (*dir_)[c].load(std::memory_order_acquire);
+      if (ch == nullptr) {
+        continue;
+      }
+      for (auto p = size_type{0U}; p != ch->size(); ++p) {
+        auto const* pg = (*ch)[p].load(std::memory_order_acquire);
+        if (pg == nullptr) {
+          continue;
+        }
+        auto const page_start = ((c << kChunkBits) + p) << kPageBits;
+        for (auto w = size_type{0U}; w != page::kWords; ++w) {
+          for (auto bits = pg->multi_[w]; bits != 0U; bits &= bits - 1U) {
+            fn(page_start + w * 64U + std::countr_zero(bits));
+          }
+        }
       }
-    } else {
-      once_.set(i, true);
     }
   }
 
-  size_type size() const noexcept { return once_.size(); }
+  // Number of allocated bitmap pages.
+  size_type n_pages() const noexcept { return n_pages_.load(); }
 
-  void reserve(size_type const size) {
-    once_.blocks_.reserve(size / bitvec64::bits_per_block);
-    multi_.blocks_.reserve(size / bitvec64::bits_per_block);
+  void clear() {
+    if (dir_ == nullptr) {
+      return;
+    }
+    for (auto& c : *dir_) {
+      auto* ch = c.exchange(nullptr);
+      if (ch == nullptr) {
+        continue;
+      }
+      for (auto& p : *ch) {
+        delete p.exchange(nullptr);
+      }
+      delete ch;
+    }
+    n_pages_ = 0U;
+    size_ = 0U;
+  }
+
+private:
+  static size_type word(size_type const i) {
+    return (i & ((size_type{1U} << kPageBits) - 1U)) / 64U;
+  }
+
+  static std::uint64_t bit(size_type const i) {
+    return std::uint64_t{1U} << (i % 64U);
+  }
+
+  static size_type chunk_idx(size_type const i) {
+    return i >> (kPageBits + kChunkBits);
+  }
+
+  static size_type page_idx(size_type const i) {
+    return (i >> kPageBits) & ((size_type{1U} << kChunkBits) - 1U);
+  }
+
+  page const* find_page(size_type const i) const {
+    if (i >= kMaxId) {
+      return nullptr;
+    }
+    auto const* ch = (*dir_)[chunk_idx(i)].load(std::memory_order_acquire);
+    return ch == nullptr ? nullptr
+                         : (*ch)[page_idx(i)].load(std::memory_order_acquire);
+  }
+
+  // Allocates on first use. Threads racing for the same slot all allocate,
+  // the first compare_exchange wins and the others discard their copy.
+  template <typename T>
+  static T& get_or_create(std::atomic<T*>& slot, bool& created) {
+    auto* x = slot.load(std::memory_order_acquire);
+    if (x != nullptr) {
+      return *x;
+    }
+    auto fresh = std::make_unique<T>();
+    if (slot.compare_exchange_strong(x, fresh.get(),
+                                     std::memory_order_acq_rel)) {
+      created = true;
+      return *fresh.release();
+    }
+    return *x;
+  }
+
+  page& get_page(size_type const i) {
+    auto created = false;
+    auto& ch = get_or_create((*dir_)[chunk_idx(i)], created);
+    created = false;
+    auto& p = get_or_create(ch[page_idx(i)], created);
+    if (created) {
+      ++n_pages_;
+    }
+    return p;
   }
 
-  bitvec64 once_, multi_;
+  std::unique_ptr<directory> dir_;
+  std::atomic<size_type> size_{0U};
+  std::atomic<size_type> n_pages_{0U};
 };
 
-}  // namespace osr
\ No newline at end of file
+}  // namespace osr
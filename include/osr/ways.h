@@ -9,13 +9,18 @@
 #include <sys/mman.h>
 #endif
 #include <filesystem>
+#include <limits>
 #include <ranges>
+#include <span>
+#include <vector>
 
 #include "fmt/ranges.h"
 #include "fmt/std.h"
 
 #include "osmium/osm/way.hpp"
 
+#include "geo/polyline.h"
+
 #include "cista/memory_holder.h"
 
 #include "utl/enumerate.h"
@@ -28,6 +33,7 @@
 
 #include "osr/point.h"
 #include "osr/types.h"
+#include "osr/util/delta_varint.h"
 #include "osr/util/multi_counter.h"
 
 namespace osr {
@@ -142,6 +148,14 @@ struct ways {
   void add_restriction(std::vector<resolved_restriction>&);
   void connect_ways();
 
+  // Builds way_polylines_packed_ and way_osm_nodes_packed_ and drops the
+  // raw way_polylines_ and way_osm_nodes_.
+  void pack_geometry();
+
+  // Replaces way geometries (same number of points), sorted by way.
+  void set_way_polylines(
+      std::vector<std::pair<way_idx_t, std::vector<point>>> const&);
+
   std::optional<way_idx_t> find_way(osm_way_idx_t const i) {
     auto const it = std::lower_bound(begin(way_osm_idx_), end(way_osm_idx_), i);
     return it != end(way_osm_idx_) && *it == i
@@ -167,16 +181,74 @@ struct ways {
   }
 
   point get_node_pos(node_idx_t const i) const {
-    auto const osm_idx = node_to_osm_[i];
     auto const way = r_->node_ways_[i][0];
-    for (auto const [o, p] :
-         utl::zip(way_osm_nodes_[way], way_polylines_[way])) {
-      if (o == osm_idx) {
-        return p;
+    auto const way_node = r_->node_in_way_idx_[i][0];
+    auto const idx = way_node_polyline_idx_[way][way_node];
+    if (!is_packed()) {
+      return way_polylines_[way][idx];
+    }
+    auto pos = point{};
+    unpack_polyline(way_polyline_packed(way), idx, idx,
+                    [&](point const& p) { pos = p; });
+    return pos;
+  }
+
+  // Calls fn(point) for every point of the way geometry.
+  template <typename Fn>
+  void for_each_polyline_point(way_idx_t const way, Fn&& fn) const {
+    if (is_packed()) {
+      unpack_polyline(way_polyline_packed(way), 0U,
+                      std::numeric_limits<std::size_t>::max(), fn);
+    } else {
+      for (auto const& p : way_polylines_[way]) {
+        fn(p);
       }
     }
-    throw utl::fail("unable to find node {} [osm={}] in way {} [osm={}]", i,
-                    osm_idx, way, way_osm_idx_[way]);
+  }
+
+  // Copies (or decodes) the way geometry / OSM node ids.
+  std::vector<point> way_polyline(way_idx_t) const;
+  std::vector<osm_node_idx_t> way_osm_nodes(way_idx_t) const;
+
+  // Geometry between the way nodes at positions a <= b of the way.
+  // Raw geometry only (!is_packed()).
+  std::span<point const> way_node_polyline(way_idx_t const way,
+                                           std::uint16_t const a,
+                                           std::uint16_t const b) const {
+    auto const offsets = way_node_polyline_idx_[way];
+    auto const from = offsets[a];
+    auto const to = offsets[b];
+    return {&way_polylines_[way][from],
+            static_cast<std::size_t>(to - from) + 1U};
+  }
+
+  // Same as above, appended to out. Decodes only the points up to b if
+  // the geometry is packed.
+  void way_node_polyline(way_idx_t,
+                         std::uint16_t a,
+                         std::uint16_t b,
+                         geo::polyline& out) const;
+
+  // The raw geometry is dropped once packing is complete.
+  bool is_packed() const {
+    return way_polylines_packed_.size() != 0U && way_polylines_.size() == 0U;
+  }
+
+  std::span<std::uint8_t const> way_polyline_packed(way_idx_t const way) const {
+    return get_packed(way_polylines_packed_, way);
+  }
+
+  std::span<std::uint8_t const> way_osm_nodes_packed(
+      way_idx_t const way) const {
+    return get_packed(way_osm_nodes_packed_, way);
+  }
+
+  static std::span<std::uint8_t const> get_packed(
+      mm_vecvec<way_idx_t, std::uint8_t, std::uint64_t> const& v,
+      way_idx_t const way) {
+    auto const from = v.bucket_starts_[to_idx(way)];
+    auto const to = v.bucket_starts_[to_idx(way) + 1U];
+    return {v.data_.data() + from, static_cast<std::size_t>(to - from)};
   }
 
   cista::mmap mm(char const* file) {
@@ -256,9 +328,17 @@ struct ways {
   mm_vec_map<way_idx_t, osm_way_idx_t> way_osm_idx_;
   mm_vecvec<way_idx_t, point, std::uint64_t> way_polylines_;
   mm_vecvec<way_idx_t, osm_node_idx_t, std::uint64_t> way_osm_nodes_;
+  mm_vecvec<way_idx_t, std::uint16_t, std::uint64_t> way_node_polyline_idx_;
   mm_vecvec<string_idx_t, char, std::uint64_t> strings_;
   mm_vec_map<way_idx_t, string_idx_t> way_names_;
 
+  // Optional zig-zag delta varint coded way_polylines_ and way_osm_nodes_
+  // (see util/delta_varint.h), empty if not packed. Replace the raw
+  // vectors, which are empty if packed. osr-microbenchmark reports the
+  // disk and page cache footprint.
+  mm_vecvec<way_idx_t, std::uint8_t, std::uint64_t> way_polylines_packed_;
+  mm_vecvec<way_idx_t, std::uint8_t, std::uint64_t> way_osm_nodes_packed_;
+
   multi_counter node_way_counter_;
 };
 
@@ -0,0 +1,125 @@
+#include "osr/extract/checkpoint.h"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "fmt/ostream.h"
+#include "fmt/std.h"
+
+#include "cista/hash.h"
+
+#include "utl/verify.h"
+
+namespace fs = std::filesystem;
+
+namespace osr {
+
+namespace {
+
+constexpr auto const kManifest = "extract_checkpoint.txt";
+constexpr auto const kFormatVersion = 1U;
+
+}  // namespace
+
+std::string_view to_str(extract_phase const p) {
+  switch (p) {
+    case extract_phase::kNone: return "none";
+    case extract_phase::kWays: return "ways";
+    case extract_phase::kConnectWays: return "connect_ways";
+    case extract_phase::kNodeProperties: return "node_properties";
+    case extract_phase::kRestrictions: return "restrictions";
+    case extract_phase::kRtree: return "rtree";
+  }
+  throw utl::fail("{} is not a valid phase", static_cast<std::uint8_t>(p));
+}
+
+std::uint64_t hash_file(fs::path const& p) {
+  auto in = std::ifstream{p, std::ios::binary};
+  utl::verify(in.good(), "hash_file: cannot open {}", p);
+
+  auto buf = std::vector<char>(16U * 1024U * 1024U);
+  auto h = cista::BASE_HASH;
+  while (in) {
+    in.read(buf.data(), static_cast<std::streamsize>(buf.size()));
+    auto const n = static_cast<std::size_t>(in.gcount());
+    h = cista::hash(std::string_view{buf.data(), n}, h);
+  }
+  return h;
+}
+
+std::optional<checkpoint> read_checkpoint(fs::path const& dir) {
+  auto in = std::ifstream{dir / kManifest};
+  if (!in) {
+    return std::nullopt;
+  }
+
+  auto c = checkpoint{};
+  auto version = 0U;
+  auto phase = std::string{};
+  auto key = std::string{};
+  while (in >> key) {
+    if (key == "version") {
+      in >> version;
+    } else if (key == "input_hash") {
+      in >> c.input_hash_;
+    } else if (key == "options_hash") {
+      in >> c.options_hash_;
+    } else if (key == "phase") {
+      in >> phase;
+    } else if (key == "file") {
+      auto& [name, size] = c.files_.emplace_back();
+      in >> name >> size;
+    } else {
+      return std::nullopt;
+    }
+  }
+
+  for (auto const p :
+       {extract_phase::kNone, extract_phase::kWays, extract_phase::kConnectWays,
+        extract_phase::kNodeProperties, extract_phase::kRestrictions,
+        extract_phase::kRtree}) {
+    if (to_str(p) == phase) {
+      c.phase_ = p;
+      return version == kFormatVersion ? std::optional{c} : std::nullopt;
+    }
+  }
+  return std::nullopt;
+}
+
+void write_checkpoint(fs::path const& dir, checkpoint& c) {
+  c.files_.clear();
+  for (auto const& e : fs::directory_iterator{dir}) {
+    auto const name = e.path().filename().generic_string();
+    if (e.is_regular_file() && !name.starts_with(kManifest) &&
+        !name.starts_with("tmp_")) {
+      c.files_.emplace_back(name, static_cast<std::uint64_t>(e.file_size()));
+    }
+  }
+
+  auto const tmp = dir / fmt::format("{}.tmp", kManifest);
+  {
+    auto out = std::ofstream{tmp};
+    fmt::print(out, "version {}\ninput_hash {}\noptions_hash {}\nphase {}\n",
+               kFormatVersion, c.input_hash_, c.options_hash_,
+               to_str(c.phase_));
+    for (auto const& [name, size] : c.files_) {
+      fmt::print(out, "file {} {}\n", name, size);
+    }
+    out.flush();
+    utl::verify(out.good(), "write_checkpoint: cannot write {}", tmp);
+  }
+  fs::rename(tmp, dir / kManifest);
+}
+
+void restore_checkpoint(fs::path const& dir, checkpoint const& c) {
+  for (auto const& [name, size] : c.files_) {
+    auto const p = dir / name;
+    utl::verify(fs::is_regular_file(p), "restore_checkpoint: {} missing", p);
+    if (fs::file_size(p) != size) {
+      fs::resize_file(p, size);
+    }
+  }
+}
+
+}  // namespace osr
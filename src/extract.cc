@@ -6,17 +6,31 @@
 
 #include "osr/extract/extract.h"
 
-#include "boost/thread/tss.hpp"
+#include <memory>
+#include <ranges>
+#include <span>
+#include <variant>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
 
 #include "fmt/core.h"
 #include "fmt/std.h"
 
 #include "oneapi/tbb/parallel_pipeline.h"
 
+#include "cista/hash.h"
+#include "cista/io.h"
+
 #include "osmium/area/assembler.hpp"
 #include "osmium/area/multipolygon_manager.hpp"
 #include "osmium/handler/node_locations_for_ways.hpp"
+#include "osmium/index/map/dense_mem_array.hpp"
 #include "osmium/index/map/flex_mem.hpp"
+#include "osmium/index/map/sparse_mem_array.hpp"
 #include "osmium/io/pbf_input.hpp"
 #include "osmium/io/xml_input.hpp"
 
@@ -24,10 +38,15 @@
 #include "utl/helpers/algorithm.h"
 #include "utl/parser/arg_parser.h"
 #include "utl/progress_tracker.h"
+#include "utl/verify.h"
 
 #include "tiles/osm/hybrid_node_idx.h"
 #include "tiles/osm/tmp_file.h"
 
+#include "osr/extract/checkpoint.h"
+#include "osr/extract/profile.h"
+#include "osr/extract/properties.h"
+#include "osr/extract/region.h"
 #include "osr/extract/tags.h"
 #include "osr/lookup.h"
 #include "osr/platforms.h"
@@ -42,12 +61,42 @@ using namespace std::string_view_literals;
 
 namespace osr {
 
+constexpr auto const kBufferMemoryEstimate = std::size_t{32U} * 1024U * 1024U;
+
+// In-memory state persisted for checkpoints, see checkpoint.h.
+constexpr auto const kCheckpointStagedNodes = "checkpoint_staged_nodes.bin";
+constexpr auto const kCheckpointStagedRestrictions =
+    "checkpoint_staged_restrictions.bin";
+constexpr auto const kCheckpointPlatformNodes =
+    "checkpoint_platform_nodes.bin";
+constexpr auto const kCheckpointElevatorNodes =
+    "checkpoint_elevator_nodes.bin";
+constexpr auto const kCheckpointGraphNodes = "checkpoint_graph_nodes.bin";
+constexpr auto const kCheckpointRestrictions = "checkpoint_restrictions.bin";
+
+template <typename Range>
+void write_vec(fs::path const& p, Range const& data) {
+  auto v = mm_vec<std::ranges::range_value_t<Range>>{cista::mmap{
+      p.generic_string().c_str(), cista::mmap::protection::WRITE}};
+  for (auto const& x : data) {
+    v.push_back(x);
+  }
+}
+
+template <typename T>
+std::vector<T> read_vec(fs::path const& p) {
+  auto const v = mm_vec<T>{
+      cista::mmap{p.generic_string().c_str(), cista::mmap::protection::READ}};
+  return {begin(v), end(v)};
+}
+
 struct osm_restriction {
   bool valid() const {
     return from_ != osm_way_idx_t::invalid() &&
            to_ != osm_way_idx_t::invalid() && via_ != osm_node_idx_t::invalid();
   }
 
+  resolved_restriction::type type_{resolved_restriction::type::kNo};
   osm_way_idx_t from_{osm_way_idx_t::invalid()};
   osm_way_idx_t to_{osm_way_idx_t::invalid()};
   osm_node_idx_t via_{osm_node_idx_t::invalid()};
@@ -135,7 +184,11 @@ std::pair<node_properties, level_bits_t> get_node_properties(tags const& t) {
   return {p, t.level_bits_};
 }
 
-struct way_handler : public osm::handler::Handler {
+bool in_region(region const* r, osm::Location const& l) {
+  return r == nullptr || (l.valid() && r->contains({l.lat(), l.lon()}));
+}
+
+struct way_handler {
   using is_transparent = void;
 
   struct strings_hash {
@@ -166,19 +219,54 @@ struct way_handler : public osm::handler::Handler {
     mm_vecvec<string_idx_t, char, std::uint64_t> const* strings_{nullptr};
   };
 
+  // Result of the parallel stage for one input buffer. Entries point into
+  // buf_ which is kept alive until the batch has been merged.
+  struct batch {
+    struct entry {
+      osm::Way const* way_;
+      way_properties p_;
+      std::string_view name_;
+      bool is_platform_;
+      platform_idx_t rel_platform_;
+    };
+
+    osm_mem::Buffer buf_;
+    std::vector<entry> ways_;
+    std::vector<std::pair<osm_node_idx_t, level_bits_t>> elevator_nodes_;
+  };
+
   way_handler(ways& w,
               platforms* platforms,
               rel_ways_t const& rel_ways,
-              hash_map<osm_node_idx_t, level_bits_t>& elevator_nodes)
+              hash_map<osm_node_idx_t, level_bits_t>& elevator_nodes,
+              region const* r)
       : w_{w},
         platforms_{platforms},
         rel_ways_{rel_ways},
-        elevator_nodes_{elevator_nodes} {
+        elevator_nodes_{elevator_nodes},
+        region_{r} {
     strings_set_.hash_function().strings_ = &w_.strings_;
     strings_set_.key_eq().strings_ = &w_.strings_;
   }
 
-  void way(osm::Way const& w) {
+  // Thread-safe: reads rel_ways_, counts node references (concurrent
+  // counter) and writes everything else to the batch.
+  batch stage(osm_mem::Buffer&& buf) const {
+    auto b = batch{.buf_ = std::move(buf)};
+    for (auto const& w : b.buf_.select<osm::Way>()) {
+      stage(b, w);
+    }
+    return b;
+  }
+
+  void stage(batch& b, osm::Way const& w) const {
+    if (region_ != nullptr &&
+        !utl::any_of(w.nodes(), [&](osm::NodeRef const& n) {
+          return in_region(region_, n.location());
+        })) {
+      return;  // ways crossing the region boundary are kept
+    }
+
     auto const osm_way_idx = osm_way_idx_t{w.positive_id()};
     auto const it = rel_ways_.find(osm_way_idx);
     auto t = tags{w};
@@ -187,9 +275,8 @@ struct way_handler : public osm::handler::Handler {
       if (w.nodes().front() != w.nodes().back()) {
         return;  // way elevators have to be loops
       }
-      auto const first_node = osm_node_idx_t{w.nodes().front().positive_ref()};
-      auto const l = std::scoped_lock{elevator_nodes_mutex_};
-      elevator_nodes_.emplace(first_node, t.level_bits_);
+      b.elevator_nodes_.emplace_back(
+          osm_node_idx_t{w.nodes().front().positive_ref()}, t.level_bits_);
     }
 
     if (!t.is_elevator_ &&  // elevators tagged as building would be landuse
@@ -212,119 +299,224 @@ struct way_handler : public osm::handler::Handler {
       p.to_level_ = it->second.p_.to_level_;
     }
 
+    for (auto const& n : w.nodes()) {
+      w_.node_way_counter_.increment(n.positive_ref());
+    }
+
+    b.ways_.push_back(
+        {.way_ = &w,
+         .p_ = p,
+         .name_ = t.name_.empty() ? t.ref_ : t.name_,
+         .is_platform_ =
+             t.is_platform_ || p.is_platform_ ||
+             (it != end(rel_ways_) && it->second.p_.is_platform_),
+         .rel_platform_ = it == end(rel_ways_) ? platform_idx_t::invalid()
+                                               : it->second.pl_});
+  }
+
+  // Not thread-safe: has to be called with batches in input order to
+  // get reproducible way indices.
+  void merge(batch const& b) {
+    for (auto const& [n, levels] : b.elevator_nodes_) {
+      elevator_nodes_.emplace(n, levels);
+    }
+
     auto const get_point = [](osmium::NodeRef const& n) {
       return point::from_location(n.location());
     };
 
-    auto const get_node_id = [&](osmium::NodeRef const& n) {
-      w_.node_way_counter_.increment(n.positive_ref());
+    auto const get_node_id = [](osmium::NodeRef const& n) {
       return osm_node_idx_t{n.positive_ref()};
     };
 
-    auto l = std::scoped_lock{mutex_};
-    auto const way_idx = way_idx_t{w_.way_osm_idx_.size()};
+    for (auto const& x : b.ways_) {
+      auto const& w = *x.way_;
+      auto const way_idx = way_idx_t{w_.way_osm_idx_.size()};
 
-    if (platforms_ != nullptr &&
-        (t.is_platform_ || p.is_platform_ ||
-         (it != end(rel_ways_) && it->second.p_.is_platform_))) {
-      platforms_->way(way_idx, w);
-    }
-
-    if (it != end(rel_ways_) && it->second.pl_ != platform_idx_t::invalid()) {
-      platforms_->platform_ref_[it->second.pl_].push_back(to_value(way_idx));
-    }
+      if (platforms_ != nullptr && x.is_platform_) {
+        platforms_->way(way_idx, w);
+      }
 
-    w_.way_osm_idx_.push_back(osm_way_idx_t{w.positive_id()});
-    w_.way_polylines_.emplace_back(w.nodes() |
-                                   std::views::transform(get_point));
-    w_.way_osm_nodes_.emplace_back(w.nodes() |
-                                   std::views::transform(get_node_id));
-    w_.r_->way_properties_.emplace_back(p);
+      if (x.rel_platform_ != platform_idx_t::invalid()) {
+        platforms_->platform_ref_[x.rel_platform_].push_back(
+            to_value(way_idx));
+      }
 
-    auto const name = t.name_.empty() ? t.ref_ : t.name_;
-    if (!name.empty()) {
-      auto str_idx = string_idx_t::invalid();
-      if (auto const string_it = strings_set_.find(name);
-          string_it != end(strings_set_)) {
-        str_idx = *string_it;
+      w_.way_osm_idx_.push_back(osm_way_idx_t{w.positive_id()});
+      w_.way_polylines_.emplace_back(w.nodes() |
+                                     std::views::transform(get_point));
+      w_.way_osm_nodes_.emplace_back(w.nodes() |
+                                     std::views::transform(get_node_id));
+      w_.r_->way_properties_.emplace_back(x.p_);
+
+      if (!x.name_.empty()) {
+        auto str_idx = string_idx_t::invalid();
+        if (auto const string_it = strings_set_.find(x.name_);
+            string_it != end(strings_set_)) {
+          str_idx = *string_it;
+        } else {
+          str_idx = string_idx_t{w_.strings_.size()};
+          w_.strings_.emplace_back(x.name_);
+        }
+        w_.way_names_.emplace_back(str_idx);
       } else {
-        str_idx = string_idx_t{w_.strings_.size()};
-        w_.strings_.emplace_back(name);
+        w_.way_names_.emplace_back(string_idx_t::invalid());
       }
-      w_.way_names_.emplace_back(str_idx);
-    } else {
-      w_.way_names_.emplace_back(string_idx_t::invalid());
     }
   }
 
   using strings_set_t = hash_set<string_idx_t, strings_hash, strings_equals>;
   strings_set_t strings_set_;
 
-  std::mutex mutex_;
   ways& w_;
   platforms* platforms_;
   rel_ways_t const& rel_ways_;
-
-  std::mutex elevator_nodes_mutex_;
   hash_map<osm_node_idx_t, level_bits_t>& elevator_nodes_;
+  region const* region_;
 };
 
-struct node_handler : public osm::handler::Handler {
-  struct cache {
-    void clear() {
-      from_.clear();
-      to_.clear();
+// Stays in RAM (std::vector) or, in low memory mode, goes to a temporary
+// mmap'd file, so the OS can evict it under memory pressure.
+template <typename T>
+struct spill_vec {
+  spill_vec() = default;
+  spill_vec(spill_vec const&) = delete;
+  spill_vec& operator=(spill_vec const&) = delete;
+
+  ~spill_vec() {
+    if (file_.has_value()) {
+      file_.reset();
+      auto ec = std::error_code{};
+      fs::remove(path_, ec);
     }
-    std::vector<way_idx_t> from_, to_;
+  }
+
+  void spill_to(fs::path const& p) {
+    path_ = p;
+    file_.emplace(cista::mmap{p.generic_string().c_str(),
+                              cista::mmap::protection::WRITE});
+  }
+
+  void push_back(T const& x) {
+    if (file_.has_value()) {
+      file_->push_back(x);
+    } else {
+      mem_.push_back(x);
+    }
+  }
+
+  std::span<T const> view() const {
+    return file_.has_value()
+               ? std::span<T const>{file_->data(),
+                                    static_cast<std::size_t>(file_->size())}
+               : std::span<T const>{mem_};
+  }
+
+  std::vector<T> mem_;
+  std::optional<mm_vec<T>> file_;
+  fs::path path_;
+};
+
+// Looks up OSM node ids that are (mostly) ascending, like nodes in a PBF.
+// Gallops forward from the previous match instead of a full binary search
+// over node_to_osm_ per id. Falls back to the start for smaller ids.
+struct node_cursor {
+  explicit node_cursor(ways const& w) : w_{w} {}
+
+  std::optional<node_idx_t> find(osm_node_idx_t const i) {
+    auto const b = begin(w_.node_to_osm_);
+    auto const size = static_cast<std::size_t>(w_.node_to_osm_.size());
+    if (i < last_) {
+      pos_ = 0U;
+    }
+    last_ = i;
+
+    auto lo = pos_;
+    auto step = std::size_t{1U};
+    while (lo + step < size && *(b + lo + step) < i) {
+      lo += step + 1U;
+      step *= 2U;
+    }
+    auto const hi = std::min(lo + step, size);
+    pos_ = static_cast<std::size_t>(
+        std::distance(b, std::lower_bound(b + lo, b + hi, i)));
+
+    if (pos_ == size || *(b + pos_) != i) {
+      return std::nullopt;
+    }
+    return node_idx_t{static_cast<node_idx_t::value_t>(pos_)};
+  }
+
+  ways const& w_;
+  std::size_t pos_{0U};
+  osm_node_idx_t last_{0U};
+};
+
+// Runs in the first pass (nodes + relations) and keeps only what is needed
+// to set node properties and restrictions once the graph nodes are known:
+// nodes with non-default properties, platform nodes and restrictions with
+// their OSM ids. This saves a third pass over the input file.
+struct node_handler : public osm::handler::Handler {
+  struct staged_node {
+    osm_node_idx_t osm_idx_;
+    node_properties p_;
+    level_bits_t level_bits_;
   };
 
-  node_handler(ways& w,
-               platforms* platforms,
-               std::vector<resolved_restriction>& r,
-               hash_map<osm_node_idx_t, level_bits_t> const& elevator_nodes)
-      : platforms_{platforms}, r_{r}, w_{w}, elevator_nodes_{elevator_nodes} {
-    w_.r_->node_properties_.resize(w_.n_nodes());
+  explicit node_handler(bool const track_platforms)
+      : track_platforms_{track_platforms},
+        default_{get_node_properties(tags{}).first} {}
+
+  void spill_to(fs::path const& dir) {
+    nodes_.spill_to(dir / "tmp_staged_nodes.bin");
+    restrictions_.spill_to(dir / "tmp_staged_restrictions.bin");
   }
 
-  void node(osm::Node const& n) {
-    auto const osm_node_idx = osm_node_idx_t{n.id()};
-    if (auto const node_idx = w_.find_node_idx(osm_node_idx);
-        node_idx.has_value()) {
-      auto const t = tags{n};
-      auto const [p, level_bits] = get_node_properties(t);
-      w_.r_->node_properties_[*node_idx] = p;
-
-      if (platforms_ != nullptr && t.is_platform_) {
-        auto const l = std::lock_guard{platforms_mutex_};
-        platforms_->node(*node_idx, n);
-      }
+  void save(fs::path const& dir) const {
+    write_vec(dir / kCheckpointStagedNodes, nodes_.view());
+    write_vec(dir / kCheckpointStagedRestrictions, restrictions_.view());
+    write_vec(dir / kCheckpointPlatformNodes,
+              std::span{reinterpret_cast<char const*>(platform_nodes_.data()),
+                        platform_nodes_.committed()});
+  }
 
-      if (p.is_elevator() && p.is_multi_level()) {
-        auto const l = std::scoped_lock{multi_level_elevators_mutex_};
-        w_.r_->multi_level_elevators_.emplace_back(*node_idx, level_bits);
-      } else if (auto const it = elevator_nodes_.find(osm_node_idx);
-                 it != end(elevator_nodes_)) {
-        auto const [from, to, is_multi] = get_levels(true, it->second);
-        auto& x = w_.r_->node_properties_[*node_idx];
-        x.is_elevator_ = true;
-        x.from_level_ = to_idx(from);
-        x.to_level_ = to_idx(to);
-        x.is_multi_level_ = is_multi;
-        if (is_multi) {
-          auto const l = std::scoped_lock{multi_level_elevators_mutex_};
-          w_.r_->multi_level_elevators_.emplace_back(*node_idx, it->second);
-        }
-      }
+  void load(fs::path const& dir) {
+    for (auto const& x : read_vec<staged_node>(dir / kCheckpointStagedNodes)) {
+      nodes_.push_back(x);
+    }
+    for (auto const& x :
+         read_vec<osm_restriction>(dir / kCheckpointStagedRestrictions)) {
+      restrictions_.push_back(x);
+    }
+    auto const platform_nodes =
+        read_vec<char>(dir / kCheckpointPlatformNodes);
+    if (!platform_nodes.empty()) {
+      std::memcpy(platform_nodes_.reserve_space(platform_nodes.size()),
+                  platform_nodes.data(), platform_nodes.size());
+      platform_nodes_.commit();
     }
   }
 
-  void relation(osm::Relation const& r) {
-    static auto c = boost::thread_specific_ptr<cache>{};
-    if (c.get() == nullptr) {
-      c.reset(new cache{});
+  // Not clipped: ways crossing the region border keep their outside
+  // nodes. resolve() drops everything that is not a graph node.
+  void node(osm::Node const& n) {
+    if (n.tags().empty()) {
+      return;
+    }
+
+    auto const t = tags{n};
+    auto const [p, level_bits] = get_node_properties(t);
+    if (std::memcmp(&p, &default_, sizeof(node_properties)) != 0) {
+      nodes_.push_back({osm_node_idx_t{n.id()}, p, level_bits});
+    }
+
+    if (track_platforms_ && t.is_platform_) {
+      platform_nodes_.add_item(n);
+      platform_nodes_.commit();
     }
-    c->clear();
+  }
 
+  void relation(osm::Relation const& r) {
     auto const type = r.tags()["type"];
     if (type == nullptr || type != "restriction"sv) {
       return;
@@ -345,65 +537,122 @@ struct node_handler : public osm::handler::Handler {
       return;
     }
 
-    auto via = node_idx_t::invalid();
+    from_.clear();
+    to_.clear();
+    auto via = osm_node_idx_t::invalid();
+    auto n_via_nodes = 0U;
     for (auto const& m : r.members()) {
       switch (cista::hash(std::string_view{m.role()})) {
-        case cista::hash("to"): {
-          auto const to = w_.find_way(osm_way_idx_t{m.positive_ref()});
-          if (to.has_value()) {
-            c->to_.emplace_back(*to);
-          }
+        case cista::hash("to"):
+          to_.emplace_back(osm_way_idx_t{m.positive_ref()});
           break;
-        }
 
-        case cista::hash("from"): {
-          auto const from = w_.find_way(osm_way_idx_t{m.positive_ref()});
-          if (from.has_value()) {
-            c->from_.emplace_back(*from);
-          }
+        case cista::hash("from"):
+          from_.emplace_back(osm_way_idx_t{m.positive_ref()});
           break;
-        }
 
         case cista::hash("via"):
           if (m.type() == osmium::item_type::node) {
-            auto const v = w_.find_node_idx(osm_node_idx_t{m.positive_ref()});
-            if (v.has_value()) {
-              via = *v;
-            }
+            via = osm_node_idx_t{m.positive_ref()};
+            ++n_via_nodes;
           }
           break;
       }
     }
 
-    if (via == node_idx_t::invalid() || c->from_.empty() || c->to_.empty()) {
-      return;
+    if (n_via_nodes != 1U) {
+      return;  // no via node (via way) or ambiguous
     }
 
-    auto const l = std::scoped_lock{r_mutex_};
-    for (auto const& from : c->from_) {
-      for (auto const& to : c->to_) {
-        r_.emplace_back(resolved_restriction{restriction_type, from, to, via});
+    for (auto const& from : from_) {
+      for (auto const& to : to_) {
+        auto const x = osm_restriction{restriction_type, from, to, via};
+        if (x.valid()) {
+          restrictions_.push_back(x);
+        }
       }
     }
   }
 
-  std::mutex platforms_mutex_;
-  platforms* platforms_;
+  // Call after ways::connect_ways() when the graph nodes are known.
+  void resolve(ways& w,
+               platforms* pl,
+               hash_map<osm_node_idx_t, level_bits_t> const& elevator_nodes,
+               std::vector<resolved_restriction>& r) {
+    w.r_->node_properties_.resize(w.n_nodes(), default_);
+
+    auto nodes = node_cursor{w};
+    for (auto const& [osm_node_idx, p, level_bits] : nodes_.view()) {
+      auto const node_idx = nodes.find(osm_node_idx);
+      if (!node_idx.has_value()) {
+        continue;
+      }
+      w.r_->node_properties_[*node_idx] = p;
+      if (p.is_elevator() && p.is_multi_level()) {
+        w.r_->multi_level_elevators_.emplace_back(*node_idx, level_bits);
+      }
+    }
 
-  std::mutex multi_level_elevators_mutex_;
+    auto sorted_elevator_nodes =
+        std::vector<std::pair<osm_node_idx_t, level_bits_t>>{
+            begin(elevator_nodes), end(elevator_nodes)};
+    utl::sort(sorted_elevator_nodes);
+    auto elevators = node_cursor{w};
+    for (auto const& [osm_node_idx, level_bits] : sorted_elevator_nodes) {
+      auto const node_idx = elevators.find(osm_node_idx);
+      if (!node_idx.has_value()) {
+        continue;
+      }
+      auto& x = w.r_->node_properties_[*node_idx];
+      if (x.is_elevator() && x.is_multi_level()) {
+        continue;  // node tags take precedence
+      }
+      auto const [from, to, is_multi] = get_levels(true, level_bits);
+      x.is_elevator_ = true;
+      x.from_level_ = to_idx(from);
+      x.to_level_ = to_idx(to);
+      x.is_multi_level_ = is_multi;
+      if (is_multi) {
+        w.r_->multi_level_elevators_.emplace_back(*node_idx, level_bits);
+      }
+    }
 
-  std::vector<resolved_restriction>& r_;
-  std::mutex r_mutex_;
+    if (pl != nullptr) {
+      auto platform_nodes = node_cursor{w};
+      for (auto const& n : platform_nodes_.select<osm::Node>()) {
+        auto const node_idx = platform_nodes.find(osm_node_idx_t{n.id()});
+        if (node_idx.has_value()) {
+          pl->node(*node_idx, n);
+        }
+      }
+    }
 
-  ways& w_;
+    for (auto const& x : restrictions_.view()) {
+      auto const from = w.find_way(x.from_);
+      auto const to = w.find_way(x.to_);
+      auto const via = w.find_node_idx(x.via_);
+      if (from.has_value() && to.has_value() && via.has_value()) {
+        r.push_back(resolved_restriction{x.type_, *from, *to, *via});
+      }
+    }
+  }
+
+  bool track_platforms_;
+  node_properties default_;
+
+  spill_vec<staged_node> nodes_;
+  spill_vec<osm_restriction> restrictions_;
+  osm_mem::Buffer platform_nodes_{1024U * 1024U,
+                                  osm_mem::Buffer::auto_grow::yes};
 
-  hash_map<osm_node_idx_t, level_bits_t> const& elevator_nodes_;
+  std::vector<osm_way_idx_t> from_, to_;
 };
 
 struct mark_inaccessible_handler : public osm::handler::Handler {
   explicit mark_inaccessible_handler(bool track_platforms, ways& w)
       : track_platforms_{track_platforms}, w_{w} {}
 
+  // Not clipped, see node_handler::node.
   void node(osm::Node const& n) {
     auto const t = tags{n};
     auto const accessible =
@@ -424,6 +673,13 @@ struct mark_inaccessible_handler : public osm::handler::Handler {
   ways& w_;
 };
 
+struct count_handler : public osm::handler::Handler {
+  void node(osm::Node const&) { ++n_; }
+  void relation(osm::Relation const&) { ++n_; }
+
+  std::uint64_t n_{0U};
+};
+
 struct rel_ways_handler : public osm::handler::Handler {
   explicit rel_ways_handler(platforms* pl, rel_ways_t& rel_ways)
       : pl_{pl}, rel_ways_{rel_ways} {}
@@ -450,14 +706,155 @@ struct rel_ways_handler : public osm::handler::Handler {
   rel_ways_t& rel_ways_;
 };
 
+// Node coordinates, filled in the first pass, read by the way pass.
+struct hybrid_file_idx : public osm::handler::Handler {
+  explicit hybrid_file_idx(fs::path const& out)
+      : idx_file_{(out / "idx.bin").generic_string()},
+        dat_file_{(out / "dat.bin").generic_string()},
+        idx_{idx_file_.fileno(), dat_file_.fileno()},
+        builder_{std::in_place, idx_} {}
+
+  void node(osm::Node const& n) { builder_->node(n); }
+
+  void finish() {
+    builder_->finish();
+    builder_.reset();
+  }
+
+  void update_locations(osm_mem::Buffer& buf) {
+    tiles::update_locations(idx_, buf);
+  }
+
+  tiles::tmp_file idx_file_, dat_file_;
+  tiles::hybrid_node_idx idx_;
+  std::optional<tiles::hybrid_node_idx_builder> builder_;
+};
+
+template <typename Map>
+struct mem_idx : public osm::handler::Handler {
+  void node(osm::Node const& n) { map_.set(n.positive_id(), n.location()); }
+
+  void finish() { map_.sort(); }
+
+  void update_locations(osm_mem::Buffer& buf) const {
+    for (auto& w : buf.select<osm::Way>()) {
+      for (auto& n : w.nodes()) {
+        n.set_location(map_.get_noexcept(n.positive_ref()));
+      }
+    }
+  }
+
+  Map map_;
+};
+
+using dense_mem_idx = mem_idx<osm::index::map::DenseMemArray<
+    osm::unsigned_object_id_type, osm::Location>>;
+using sparse_mem_idx = mem_idx<osm::index::map::SparseMemArray<
+    osm::unsigned_object_id_type, osm::Location>>;
+using node_location_idx = std::variant<std::unique_ptr<hybrid_file_idx>,
+                                       std::unique_ptr<dense_mem_idx>,
+                                       std::unique_ptr<sparse_mem_idx>>;
+
+std::size_t get_available_memory() {
+#ifdef _WIN32
+  auto status = MEMORYSTATUSEX{};
+  status.dwLength = sizeof(status);
+  GlobalMemoryStatusEx(&status);
+  return static_cast<std::size_t>(status.ullAvailPhys);
+#else
+  return static_cast<std::size_t>(sysconf(_SC_AVPHYS_PAGES)) *
+         static_cast<std::size_t>(sysconf(_SC_PAGE_SIZE));
+#endif
+}
+
+node_index_type choose_node_index(extract_options const& opt,
+                                  std::size_t const file_size) {
+  if (opt.node_index_ != node_index_type::kAuto) {
+    return opt.node_index_;
+  }
+
+  // PBF: ~8 bytes per node. Dense: 8 bytes per possible id. Sparse: 16
+  // bytes per node. Keep half of the memory for everything else.
+  constexpr auto const kMaxNodeId = std::size_t{1U} << 34U;
+  auto const available = (opt.memory_hint_ != 0U ? opt.memory_hint_
+                                                 : get_available_memory()) /
+                         2U;
+  auto const dense = kMaxNodeId * sizeof(osm::Location);
+  auto const sparse = file_size / 8U * 16U;
+  if (sparse > dense / 2U && dense < available) {
+    return node_index_type::kDenseMem;
+  } else if (sparse < available) {
+    return node_index_type::kSparseMem;
+  } else {
+    return node_index_type::kHybridFile;
+  }
+}
+
+node_location_idx make_node_location_idx(node_index_type const t,
+                                         fs::path const& out) {
+  switch (t) {
+    case node_index_type::kDenseMem: return std::make_unique<dense_mem_idx>();
+    case node_index_type::kSparseMem: return std::make_unique<sparse_mem_idx>();
+    case node_index_type::kAuto: [[fallthrough]];
+    case node_index_type::kHybridFile:
+      return std::make_unique<hybrid_file_idx>(out);
+  }
+  throw utl::fail("{} is not a valid node index", static_cast<std::uint8_t>(t));
+}
+
+std::string_view to_str(node_index_type const t) {
+  switch (t) {
+    case node_index_type::kAuto: return "auto";
+    case node_index_type::kDenseMem: return "dense-mem";
+    case node_index_type::kSparseMem: return "sparse-mem";
+    case node_index_type::kHybridFile: return "hybrid-file";
+  }
+  throw utl::fail("{} is not a valid node index", static_cast<std::uint8_t>(t));
+}
+
+node_index_type parse_node_index_type(std::string_view s) {
+  for (auto const t :
+       {node_index_type::kAuto, node_index_type::kDenseMem,
+        node_index_type::kSparseMem, node_index_type::kHybridFile}) {
+    if (to_str(t) == s) {
+      return t;
+    }
+  }
+  throw utl::fail(
+      "invalid node index \"{}\", expected "
+      "auto|dense-mem|sparse-mem|hybrid-file",
+      s);
+}
+
+// Options that change the output invalidate checkpoints.
+std::uint64_t get_options_hash(extract_options const& opt) {
+  auto const bbox = opt.bbox_.value_or(geo::box{});
+  return cista::hash(fmt::format(
+      "{} {} {} {} {} {} {} {}", opt.with_platforms_, opt.bbox_.has_value(),
+      bbox.min_.lat_, bbox.min_.lng_, bbox.max_.lat_, bbox.max_.lng_,
+      opt.poly_.empty() ? 0U : hash_file(opt.poly_), opt.pack_geometry_));
+}
+
 void extract(bool const with_platforms,
              fs::path const& in,
              fs::path const& out) {
-  auto ec = std::error_code{};
-  fs::remove_all(out, ec);
-  if (!fs::is_directory(out)) {
-    fs::create_directories(out);
+  extract(extract_options{.with_platforms_ = with_platforms}, in, out);
+}
+
+void extract(extract_options const& opt,
+             fs::path const& in,
+             fs::path const& out) {
+  utl::verify(!opt.bbox_.has_value() || opt.poly_.empty(),
+              "extract: use either bbox or poly");
+  utl::verify(opt.stop_after_ == extract_phase::kRtree || opt.checkpoint_,
+              "extract: stop_after requires checkpoints");
+  auto clip_region = std::optional<region>{};
+  if (opt.bbox_.has_value()) {
+    clip_region = region{.bbox_ = *opt.bbox_};
+  } else if (!opt.poly_.empty()) {
+    clip_region = read_poly(opt.poly_);
   }
+  auto const* clip = clip_region.has_value() ? &*clip_region : nullptr;
 
   auto input_file = osm_io::File{};
   auto file_size = std::size_t{0U};
@@ -470,114 +867,267 @@ void extract(bool const with_platforms,
     throw;
   }
 
-  auto pt = utl::get_active_progress_tracker_or_activate("osr");
+  // Continue after the last completed phase of a previous run.
+  auto cp = checkpoint{};
+  auto resume = extract_phase::kNone;
+  if (opt.checkpoint_) {
+    cp.input_hash_ = hash_file(in);
+    cp.options_hash_ = get_options_hash(opt);
+    auto const prev = read_checkpoint(out);
+    if (prev.has_value() && prev->input_hash_ == cp.input_hash_ &&
+        prev->options_hash_ == cp.options_hash_) {
+      resume = prev->phase_;
+      if (resume == extract_phase::kRtree) {
+        fmt::println("extract: {} is up to date", out);
+        return;
+      }
+      restore_checkpoint(out, *prev);
+      fmt::println("extract: resuming after phase {}", to_str(resume));
+    }
+  }
+
+  if (resume == extract_phase::kNone) {
+    auto ec = std::error_code{};
+    fs::remove_all(out, ec);
+    if (!fs::is_directory(out)) {
+      fs::create_directories(out);
+    }
+  }
 
-  auto const node_idx_file =
-      tiles::tmp_file{(out / "idx.bin").generic_string()};
-  auto const node_dat_file =
-      tiles::tmp_file{(out / "dat.bin").generic_string()};
-  auto node_idx =
-      tiles::hybrid_node_idx{node_idx_file.fileno(), node_dat_file.fileno()};
+  auto pt = utl::get_active_progress_tracker_or_activate("osr");
 
-  auto rel_ways = rel_ways_t{};
-  auto w = ways{out, cista::mmap::protection::WRITE};
+  auto profile = extract_profile{};
+  auto const report = [&]() {
+    profile.print();
+    profile.write_json(out / "extract_profile.json");
+  };
+  auto const mode = resume == extract_phase::kNone
+                        ? cista::mmap::protection::WRITE
+                        : cista::mmap::protection::MODIFY;
+  auto w = std::make_unique<ways>(out, mode);
   auto pl = std::unique_ptr<platforms>{};
-  if (with_platforms) {
-    pl = std::make_unique<platforms>(out, cista::mmap::protection::WRITE);
+  if (opt.with_platforms_) {
+    pl = std::make_unique<platforms>(out, mode);
   }
 
-  w.node_way_counter_.reserve(12000000000);
-  {  // Collect node coordinates.
-    pt->status("Load OSM / Coordinates").in_high(file_size).out_bounds(0, 20);
-
-    auto node_idx_builder = tiles::hybrid_node_idx_builder{node_idx};
+  // routing.bin is replaced atomically: a checkpoint may refer to it.
+  auto const write_routing = [&]() {
+    cista::write(out / "routing.bin.tmp", *w->r_);
+    fs::rename(out / "routing.bin.tmp", out / "routing.bin");
+  };
 
-    auto inaccessible_handler = mark_inaccessible_handler{pl != nullptr, w};
-    auto rel_ways_h = rel_ways_handler{pl.get(), rel_ways};
-    auto reader = osm_io::Reader{input_file, osm_eb::node | osm_eb::relation,
-                                 osmium::io::read_meta::no};
-    while (auto buffer = reader.read()) {
-      pt->update(reader.offset());
-      osm::apply(buffer, node_idx_builder, inaccessible_handler, rel_ways_h);
+  // Closing the memory mapped files truncates them to their content, so
+  // the checkpoint records the right file sizes.
+  auto const save = [&](extract_phase const phase, bool const routing) {
+    if (!opt.checkpoint_) {
+      return false;
+    }
+    if (routing) {
+      write_routing();
+    }
+    if (phase != extract_phase::kRtree) {
+      auto counter = std::move(w->node_way_counter_);
+      w = {};
+      w = std::make_unique<ways>(out, cista::mmap::protection::MODIFY);
+      w->node_way_counter_ = std::move(counter);
+      if (pl != nullptr) {
+        pl = {};
+        pl = std::make_unique<platforms>(out, cista::mmap::protection::MODIFY);
+      }
     }
-    reader.close();
-    node_idx_builder.finish();
+    cp.phase_ = phase;
+    write_checkpoint(out, cp);
+    profile.finish(fmt::format("checkpoint {}", to_str(phase)), 0U);
+    if (phase == opt.stop_after_) {
+      report();
+      return true;
+    }
+    return false;
+  };
+
+  // Low memory mode: spill staged node data to disk and limit the number of
+  // buffers in flight (~1/4 of the hint, 32 MB per decoded buffer).
+  auto const max_tokens = std::thread::hardware_concurrency() * 4U;
+  auto const n_tokens =
+      opt.memory_hint_ == 0U
+          ? max_tokens
+          : static_cast<unsigned>(std::clamp(
+                opt.memory_hint_ / 4U / kBufferMemoryEstimate,
+                std::size_t{2U}, static_cast<std::size_t>(max_tokens)));
+
+  auto node_h = node_handler{pl != nullptr};
+  if (opt.memory_hint_ != 0U) {
+    node_h.spill_to(out);
   }
 
   auto elevator_nodes = hash_map<osm_node_idx_t, level_bits_t>{};
-  {  // Extract streets, places, and areas.
-    pt->status("Load OSM / Ways").in_high(file_size).out_bounds(20, 50);
-
-    auto h = way_handler{w, pl.get(), rel_ways, elevator_nodes};
-    auto reader =
-        osm_io::Reader{input_file, osm_eb::way, osmium::io::read_meta::no};
-    oneapi::tbb::parallel_pipeline(
-        std::thread::hardware_concurrency() * 4U,
-        oneapi::tbb::make_filter<void, osm_mem::Buffer>(
-            oneapi::tbb::filter_mode::serial_in_order,
-            [&](oneapi::tbb::flow_control& fc) {
-              auto buf = reader.read();
+  if (resume == extract_phase::kNone) {
+    auto const node_index = choose_node_index(opt, file_size);
+    auto node_idx = make_node_location_idx(node_index, out);
+    fmt::println("extract: node index {}", to_str(node_index));
+
+    auto rel_ways = rel_ways_t{};
+    auto n_objects = count_handler{};
+    {  // Collect node coordinates, stage node properties + restrictions.
+      pt->status("Load OSM / Coordinates")
+          .in_high(file_size)
+          .out_bounds(0, 20);
+
+      auto inaccessible_handler =
+          mark_inaccessible_handler{pl != nullptr, *w};
+      auto rel_ways_h = rel_ways_handler{pl.get(), rel_ways};
+      auto reader = osm_io::Reader{input_file, osm_eb::node | osm_eb::relation,
+                                   osmium::io::read_meta::no};
+      std::visit(
+          [&](auto& idx) {
+            while (auto buffer = reader.read()) {
               pt->update(reader.offset());
-              if (!buf) {
-                fc.stop();
-              }
-              return buf;
-            }) &
-            oneapi::tbb::make_filter<osm_mem::Buffer, void>(
-                oneapi::tbb::filter_mode::parallel, [&](osm_mem::Buffer&& buf) {
-                  update_locations(node_idx, buf);
-                  osm::apply(buf, h);
+              osm::apply(buffer, *idx, inaccessible_handler, rel_ways_h,
+                         node_h, n_objects);
+            }
+            idx->finish();
+          },
+          node_idx);
+      reader.close();
+    }
+    profile.finish("coordinates", n_objects.n_);
+
+    {  // Extract streets, places, and areas.
+      pt->status("Load OSM / Ways").in_high(file_size).out_bounds(20, 50);
+
+      auto h = way_handler{*w, pl.get(), rel_ways, elevator_nodes, clip};
+      auto reader =
+          osm_io::Reader{input_file, osm_eb::way, osmium::io::read_meta::no};
+      oneapi::tbb::parallel_pipeline(
+          n_tokens,
+          oneapi::tbb::make_filter<void, osm_mem::Buffer>(
+              oneapi::tbb::filter_mode::serial_in_order,
+              [&](oneapi::tbb::flow_control& fc) {
+                auto buf = reader.read();
+                pt->update(reader.offset());
+                if (!buf) {
+                  fc.stop();
+                }
+                return buf;
+              }) &
+              oneapi::tbb::make_filter<osm_mem::Buffer, way_handler::batch>(
+                  oneapi::tbb::filter_mode::parallel,
+                  [&](osm_mem::Buffer&& buf) {
+                    std::visit([&](auto& idx) { idx->update_locations(buf); },
+                               node_idx);
+                    return h.stage(std::move(buf));
+                  }) &
+              oneapi::tbb::make_filter<way_handler::batch, void>(
+                  oneapi::tbb::filter_mode::serial_in_order,
+                  [&](way_handler::batch&& b) { h.merge(b); }));
+
+      pt->update(pt->in_high_);
+      reader.close();
+    }
+    rel_ways = rel_ways_t{};
+    node_idx = {};
+    profile.finish("ways", w->n_ways());
+
+    write_routing();
+    w->sync();
+
+    if (opt.checkpoint_) {
+      node_h.save(out);
+      write_vec(out / kCheckpointElevatorNodes,
+                elevator_nodes | std::views::transform([](auto const& x) {
+                  return pair<osm_node_idx_t, level_bits_t>{x.first, x.second};
                 }));
+      auto graph_nodes = mm_vec<osm_node_idx_t>{
+          cista::mmap{(out / kCheckpointGraphNodes).generic_string().c_str(),
+                      cista::mmap::protection::WRITE}};
+      w->node_way_counter_.for_each_multi([&](std::uint64_t const i) {
+        graph_nodes.push_back(osm_node_idx_t{i});
+      });
+    }
+    if (save(extract_phase::kWays, false)) {
+      return;
+    }
+  } else if (resume < extract_phase::kNodeProperties) {
+    node_h.load(out);
+    for (auto const& [n, level_bits] :
+         read_vec<pair<osm_node_idx_t, level_bits_t>>(
+             out / kCheckpointElevatorNodes)) {
+      elevator_nodes.emplace(n, level_bits);
+    }
+  }
+
+  if (resume < extract_phase::kConnectWays) {
+    if (resume == extract_phase::kWays) {  // only multi counts matter
+      for (auto const n :
+           read_vec<osm_node_idx_t>(out / kCheckpointGraphNodes)) {
+        w->node_way_counter_.increment(to_idx(n));
+        w->node_way_counter_.increment(to_idx(n));
+      }
+    }
+    w->connect_ways();
+    w->node_way_counter_.clear();  // only needed to create graph nodes
+    profile.finish("connect_ways", w->n_nodes());
+    if (save(extract_phase::kConnectWays, true)) {
+      return;
+    }
+  }
 
-    pt->update(pt->in_high_);
-    reader.close();
+  auto r = std::vector<resolved_restriction>{};
+  if (resume < extract_phase::kNodeProperties) {
+    pt->status("Node Properties").out_bounds(90, 100);
+    node_h.resolve(*w, pl.get(), elevator_nodes, r);
+    profile.finish("node_properties", w->n_nodes());
+    if (opt.checkpoint_) {
+      write_vec(out / kCheckpointRestrictions, r);
+    }
+    if (save(extract_phase::kNodeProperties, true)) {
+      return;
+    }
+  } else if (resume < extract_phase::kRestrictions) {
+    r = read_vec<resolved_restriction>(out / kCheckpointRestrictions);
   }
 
-  w.r_->write(out);
-  w.sync();
+  if (resume < extract_phase::kRestrictions) {
+    w->add_restriction(r);
 
-  w.connect_ways();
+    utl::sort(w->r_->multi_level_elevators_);
 
-  auto r = std::vector<resolved_restriction>{};
-  {
-    pt->status("Load OSM / Node Properties")
-        .in_high(file_size)
-        .out_bounds(90, 100);
-    auto reader = osm_io::Reader{input_file, osm_eb::node | osm_eb::relation,
-                                 osmium::io::read_meta::no};
-    auto h = node_handler{w, pl.get(), r, elevator_nodes};
-    oneapi::tbb::parallel_pipeline(
-        std::thread::hardware_concurrency() * 4U,
-        oneapi::tbb::make_filter<void, osm_mem::Buffer>(
-            oneapi::tbb::filter_mode::serial_in_order,
-            [&](oneapi::tbb::flow_control& fc) {
-              auto buf = reader.read();
-              pt->update(reader.offset());
-              if (!buf) {
-                fc.stop();
-              }
-              return buf;
-            }) &
-            oneapi::tbb::make_filter<osm_mem::Buffer, void>(
-                oneapi::tbb::filter_mode::parallel,
-                [&](osm_mem::Buffer&& buf) { osm::apply(buf, h); }));
+    if (pl) {
+      utl::sort(pl->node_pos_,
+                [](auto&& a, auto&& b) { return a.first < b.first; });
+    }
 
-    reader.close();
-    pt->update(pt->in_high_);
-  }
+    profile.finish("restrictions", r.size());
 
-  w.add_restriction(r);
+    write_routing();
+    profile.finish("routing.bin write", w->n_nodes());
+    if (save(extract_phase::kRestrictions, false)) {
+      return;
+    }
+  }
 
-  utl::sort(w.r_->multi_level_elevators_);
+  lookup{*w, out, cista::mmap::protection::WRITE}.build_rtree();
+  profile.finish("rtree", w->n_ways());
 
-  if (pl) {
-    utl::sort(pl->node_pos_,
-              [](auto&& a, auto&& b) { return a.first < b.first; });
+  // Last: all previous phases read the raw geometry.
+  if (opt.pack_geometry_) {
+    w->pack_geometry();
+    w->sync();
+    profile.finish("pack_geometry", w->n_ways());
   }
 
-  w.r_->write(out);
+  if (opt.checkpoint_) {
+    for (auto const f :
+         {kCheckpointStagedNodes, kCheckpointStagedRestrictions,
+          kCheckpointPlatformNodes, kCheckpointElevatorNodes,
+          kCheckpointGraphNodes, kCheckpointRestrictions}) {
+      auto ec = std::error_code{};
+      fs::remove(out / f, ec);
+    }
+    save(extract_phase::kRtree, false);
+  }
 
-  lookup{w, out, cista::mmap::protection::WRITE}.build_rtree();
+  report();
 }
 
 }  // namespace osr
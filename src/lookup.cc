@@ -13,21 +13,36 @@ lookup::lookup(ways const& ways,
                cista::mmap::protection mode)
     : p_{std::move(p)},
       mode_{mode},
-      rtree_{mode == cista::mmap::protection::READ
-                 ? *cista::read<cista::mm_rtree<way_idx_t>::meta>(
-                       p_ / "rtree_meta.bin")
-                 : cista::mm_rtree<way_idx_t>::meta{},
+      rtree_{mode == cista::mmap::protection::WRITE
+                 ? cista::mm_rtree<way_idx_t>::meta{}
+                 : *cista::read<cista::mm_rtree<way_idx_t>::meta>(
+                       p_ / "rtree_meta.bin"),
              cista::mm_rtree<way_idx_t>::vector_t{mm("rtree_data.bin")}},
       ways_{ways} {}
 
 void lookup::build_rtree() {
   for (auto way = way_idx_t{0U}; way != ways_.n_ways(); ++way) {
-    auto b = geo::box{};
-    for (auto const& c : ways_.way_polylines_[way]) {
-      b.extend(c);
-    }
-    rtree_.insert(b.min_.lnglat_float(), b.max_.lnglat_float(), way);
+    insert_way(way);
   }
+  write_rtree_meta();
+}
+
+geo::box lookup::get_way_bbox(way_idx_t const way) const {
+  auto b = geo::box{};
+  ways_.for_each_polyline_point(way, [&](point const& c) { b.extend(c); });
+  return b;
+}
+
+void lookup::insert_way(way_idx_t const way) {
+  auto const b = get_way_bbox(way);
+  rtree_.insert(b.min_.lnglat_float(), b.max_.lnglat_float(), way);
+}
+
+void lookup::remove_way(way_idx_t const way, geo::box const& b) {
+  rtree_.remove(b.min_.lnglat_float(), b.max_.lnglat_float(), way);
+}
+
+void lookup::write_rtree_meta() {
   rtree_.write_meta(p_ / "rtree_meta.bin");
 }
 
@@ -0,0 +1,163 @@
+#include "osr/extract/profile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include <fstream>
+#include <string>
+
+#include "fmt/core.h"
+#include "fmt/ostream.h"
+
+#include "utl/verify.h"
+
+namespace osr {
+
+namespace {
+
+#ifdef _WIN32
+
+double to_seconds(FILETIME const& t) {
+  return static_cast<double>((static_cast<std::uint64_t>(t.dwHighDateTime)
+                              << 32U) |
+                             t.dwLowDateTime) /
+         1E7;
+}
+
+#elif defined(__linux__)
+
+// "key: value" line of a /proc/self file, 0 if not available.
+std::uint64_t read_proc_value(char const* file, std::string_view key) {
+  auto in = std::ifstream{file};
+  auto line = std::string{};
+  while (std::getline(in, line)) {
+    if (line.starts_with(key) && line.size() > key.size() &&
+        line[key.size()] == ':') {
+      return std::stoull(line.substr(key.size() + 1U));
+    }
+  }
+  return 0U;
+}
+
+#endif
+
+// Resets the peak RSS (VmHWM) where supported.
+void reset_peak_rss() {
+#if defined(__linux__)
+  auto out = std::ofstream{"/proc/self/clear_refs"};
+  out << "5";
+#endif
+}
+
+std::uint64_t get_peak_rss() {
+#ifdef _WIN32
+  auto c = PROCESS_MEMORY_COUNTERS{};
+  GetProcessMemoryInfo(GetCurrentProcess(), &c, sizeof(c));
+  return static_cast<std::uint64_t>(c.PeakWorkingSetSize);
+#else
+#if defined(__linux__)
+  if (auto const hwm = read_proc_value("/proc/self/status", "VmHWM");
+      hwm != 0U) {
+    return hwm * 1024U;  // "VmHWM:  1234 kB"
+  }
+#endif
+  auto u = rusage{};
+  getrusage(RUSAGE_SELF, &u);
+#ifdef __APPLE__
+  return static_cast<std::uint64_t>(u.ru_maxrss);  // bytes
+#else
+  return static_cast<std::uint64_t>(u.ru_maxrss) * 1024U;  // KiB
+#endif
+#endif
+}
+
+}  // namespace
+
+extract_profile::usage extract_profile::usage::now() {
+  auto u = usage{.wall_time_ = std::chrono::steady_clock::now()};
+#ifdef _WIN32
+  auto creation = FILETIME{}, exit = FILETIME{}, kernel = FILETIME{},
+       user = FILETIME{};
+  GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user);
+  u.cpu_time_ = to_seconds(kernel) + to_seconds(user);
+
+  auto io = IO_COUNTERS{};
+  GetProcessIoCounters(GetCurrentProcess(), &io);
+  u.bytes_read_ = io.ReadTransferCount;
+  u.bytes_written_ = io.WriteTransferCount;
+#else
+  auto r = rusage{};
+  getrusage(RUSAGE_SELF, &r);
+  auto const seconds = [](timeval const& t) {
+    return static_cast<double>(t.tv_sec) + static_cast<double>(t.tv_usec) / 1E6;
+  };
+  u.cpu_time_ = seconds(r.ru_utime) + seconds(r.ru_stime);
+#if defined(__linux__)
+  u.bytes_read_ = read_proc_value("/proc/self/io", "read_bytes");
+  u.bytes_written_ = read_proc_value("/proc/self/io", "write_bytes");
+#endif
+#endif
+  return u;
+}
+
+extract_profile::extract_profile() : start_{usage::now()} {
+  reset_peak_rss();
+}
+
+void extract_profile::finish(std::string_view phase,
+                             std::uint64_t const n_objects) {
+  auto const end = usage::now();
+  phases_.push_back(phase_profile{
+      .name_ = std::string{phase},
+      .wall_time_ =
+          std::chrono::duration<double>{end.wall_time_ - start_.wall_time_}
+              .count(),
+      .cpu_time_ = end.cpu_time_ - start_.cpu_time_,
+      .peak_rss_ = get_peak_rss(),
+      .bytes_read_ = end.bytes_read_ - start_.bytes_read_,
+      .bytes_written_ = end.bytes_written_ - start_.bytes_written_,
+      .n_objects_ = n_objects});
+  reset_peak_rss();
+  start_ = usage::now();
+}
+
+void extract_profile::print() const {
+  constexpr auto const kMB = 1024.0 * 1024.0;
+  fmt::println("{:<28} {:>9} {:>9} {:>10} {:>10} {:>10} {:>12}", "phase",
+               "wall [s]", "cpu [s]", "rss [MB]", "read [MB]", "write [MB]",
+               "objects/s");
+  for (auto const& p : phases_) {
+    fmt::println(
+        "{:<28} {:>9.2f} {:>9.2f} {:>10.0f} {:>10.0f} {:>10.0f} {:>12.0f}",
+        p.name_, p.wall_time_, p.cpu_time_,
+        static_cast<double>(p.peak_rss_) / kMB,
+        static_cast<double>(p.bytes_read_) / kMB,
+        static_cast<double>(p.bytes_written_) / kMB, p.objects_per_second());
+  }
+}
+
+void extract_profile::write_json(std::filesystem::path const& p) const {
+  auto out = std::ofstream{p};
+  out << "{\"phases\": [";
+  auto first = true;
+  for (auto const& x : phases_) {
+    fmt::print(out,
+               "{}\n  {{\"name\": \"{}\", \"wall_time_s\": {:.3f}, "
+               "\"cpu_time_s\": {:.3f}, \"peak_rss_bytes\": {}, "
+               "\"bytes_read\": {}, \"bytes_written\": {}, \"objects\": {}, "
+               "\"objects_per_s\": {:.1f}}}",
+               first ? "" : ",", x.name_, x.wall_time_, x.cpu_time_,
+               x.peak_rss_, x.bytes_read_, x.bytes_written_, x.n_objects_,
+               x.objects_per_second());
+    first = false;
+  }
+  out << "\n]}\n";
+  utl::verify(out.good(), "extract_profile: cannot write {}", p.string());
+}
+
+}  // namespace osr
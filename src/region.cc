@@ -0,0 +1,115 @@
+#include "osr/extract/region.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "fmt/std.h"
+
+#include "utl/verify.h"
+
+namespace osr {
+
+namespace {
+
+// Ray casting, lng = x, lat = y.
+bool in_ring(std::vector<geo::latlng> const& ring, geo::latlng const& p) {
+  auto inside = false;
+  for (auto i = 0U, j = static_cast<unsigned>(ring.size() - 1U);
+       i < ring.size(); j = i++) {
+    auto const& a = ring[i];
+    auto const& b = ring[j];
+    if ((a.lat_ > p.lat_) == (b.lat_ > p.lat_)) {
+      continue;
+    }
+    auto const x =
+        (b.lng_ - a.lng_) * (p.lat_ - a.lat_) / (b.lat_ - a.lat_) + a.lng_;
+    if (p.lng_ < x) {
+      inside = !inside;
+    }
+  }
+  return inside;
+}
+
+}  // namespace
+
+bool region::contains(geo::latlng const& p) const {
+  if (p.lat_ < bbox_.min_.lat_ || p.lat_ > bbox_.max_.lat_ ||
+      p.lng_ < bbox_.min_.lng_ || p.lng_ > bbox_.max_.lng_) {
+    return false;
+  }
+  if (outer_.empty()) {
+    return true;
+  }
+  auto const in = [&](auto const& ring) { return in_ring(ring, p); };
+  return std::ranges::any_of(outer_, in) && std::ranges::none_of(inner_, in);
+}
+
+geo::box parse_bbox(std::string_view s) {
+  auto const str = std::string{s};
+  auto min_lng = 0.0, min_lat = 0.0, max_lng = 0.0, max_lat = 0.0;
+  utl::verify(std::sscanf(str.c_str(), "%lf,%lf,%lf,%lf", &min_lng, &min_lat,
+                          &max_lng, &max_lat) == 4,
+              "invalid bbox \"{}\", expected min_lng,min_lat,max_lng,max_lat",
+              s);
+  utl::verify(min_lng <= max_lng && min_lat <= max_lat, "empty bbox \"{}\"",
+              s);
+  return geo::box{geo::latlng{min_lat, min_lng},
+                  geo::latlng{max_lat, max_lng}};
+}
+
+region parse_poly(std::string_view s) {
+  auto r = region{};
+  auto in = std::istringstream{std::string{s}};
+  auto line = std::string{};
+  std::getline(in, line);  // name
+
+  auto ring = std::vector<geo::latlng>{};
+  auto in_ring = false;
+  auto is_hole = false;
+  while (std::getline(in, line)) {
+    auto const begin = line.find_first_not_of(" \t\r");
+    auto const token =
+        begin == std::string::npos ? std::string{} : line.substr(begin);
+    if (token.empty()) {
+      continue;
+    }
+
+    if (!in_ring) {
+      if (token.starts_with("END")) {
+        break;
+      }
+      in_ring = true;
+      is_hole = token.starts_with('!');
+      ring.clear();
+    } else if (token.starts_with("END")) {
+      utl::verify(ring.size() >= 3U, "poly: ring with {} points", ring.size());
+      for (auto const& p : ring) {
+        r.bbox_.extend(p);
+      }
+      (is_hole ? r.inner_ : r.outer_).push_back(std::move(ring));
+      ring = {};
+      in_ring = false;
+    } else {
+      auto lng = 0.0, lat = 0.0;
+      utl::verify(std::sscanf(token.c_str(), "%lf %lf", &lng, &lat) == 2,
+                  "poly: invalid coordinate line \"{}\"", token);
+      ring.emplace_back(lat, lng);
+    }
+  }
+
+  utl::verify(!r.outer_.empty(), "poly: no outer ring");
+  return r;
+}
+
+region read_poly(std::filesystem::path const& p) {
+  auto in = std::ifstream{p};
+  utl::verify(in.good(), "could not open poly file {}", p);
+  auto ss = std::stringstream{};
+  ss << in.rdbuf();
+  return parse_poly(ss.str());
+}
+
+}  // namespace osr
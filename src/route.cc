@@ -1,5 +1,7 @@
 #include "osr/routing/route.h"
 
+#include <algorithm>
+
 #include "boost/thread/tss.hpp"
 
 #include "utl/concat.h"
@@ -13,8 +15,6 @@
 #include "osr/routing/profiles/car_parking.h"
 #include "osr/routing/profiles/foot.h"
 #include "osr/routing/sharing_data.h"
-#include "osr/util/infinite.h"
-#include "osr/util/reverse.h"
 
 namespace osr {
 
@@ -23,7 +23,6 @@ struct connecting_way {
 
   way_idx_t way_{way_idx_t::invalid()};
   std::uint16_t from_{}, to_{};
-  bool is_loop_{};
   std::uint16_t distance_{};
 };
 
@@ -42,10 +41,7 @@ connecting_way find_connecting_way(ways const& w,
           distance_t const dist, way_idx_t const way, std::uint16_t const a_idx,
           std::uint16_t const b_idx) {
         if (target == to && cost == expected_cost) {
-          auto const is_loop = way != way_idx_t::invalid() && r.is_loop(way) &&
-                               static_cast<unsigned>(std::abs(a_idx - b_idx)) ==
-                                   r.way_nodes_[way].size() - 2U;
-          conn = {way, a_idx, b_idx, is_loop, dist};
+          conn = {way, a_idx, b_idx, dist};
         }
       });
   utl::verify(
@@ -84,21 +80,39 @@ connecting_way find_connecting_way(ways const& w,
   }
 }
 
+template <typename Profile>
+connecting_way get_connecting_way(ways const& w,
+                                  bitvec<node_idx_t> const* blocked,
+                                  sharing_data const* sharing,
+                                  typename Profile::entry const& e,
+                                  typename Profile::node const from,
+                                  typename Profile::node const to,
+                                  cost_t const expected_cost,
+                                  direction const dir) {
+  if constexpr (requires { e.arc(to); }) {
+    if (auto const a = e.arc(to);
+        a.has_value() && a->way_ != way_idx_t::invalid()) {
+      auto const& r = *w.r_;
+      return {.way_ = a->way_,
+              .from_ = a->from_,
+              .to_ = a->to_,
+              .distance_ =
+                  r.way_node_dist_[a->way_][std::min(a->from_, a->to_)]};
+    }
+  }
+  return find_connecting_way<Profile>(w, blocked, sharing, from, to,
+                                      expected_cost, dir);
+}
+
 template <typename Profile>
 double add_path(ways const& w,
                 ways::routing const& r,
-                bitvec<node_idx_t> const* blocked,
-                sharing_data const* sharing,
                 typename Profile::node const from,
                 typename Profile::node const to,
+                connecting_way const& conn,
                 cost_t const expected_cost,
-                std::vector<path::segment>& path,
-                direction const dir) {
-  auto const& [way, from_idx, to_idx, is_loop, distance] =
-      find_connecting_way<Profile>(w, blocked, sharing, from, to, expected_cost,
-                                   dir);
-  auto j = 0U;
-  auto active = false;
+                std::vector<path::segment>& path) {
+  auto const& [way, from_idx, to_idx, distance] = conn;
   auto& segment = path.emplace_back();
   segment.way_ = way;
   segment.dist_ = distance;
@@ -111,26 +125,10 @@ double add_path(ways const& w,
     segment.from_ = r.way_nodes_[way][from_idx];
     segment.to_ = r.way_nodes_[way][to_idx];
 
-    for (auto const [osm_idx, coord] : infinite(
-             reverse(utl::zip(w.way_osm_nodes_[way], w.way_polylines_[way]),
-                     (from_idx > to_idx) ^ is_loop),
-             is_loop)) {
-      utl::verify(j++ != 2 * w.way_polylines_[way].size() + 1U,
-                  "infinite loop");
-      if (!active && w.node_to_osm_[r.way_nodes_[way][from_idx]] == osm_idx) {
-        active = true;
-      }
-      if (active) {
-        if (w.node_to_osm_[r.way_nodes_[way][from_idx]] == osm_idx) {
-          // Again "from" node, then it's shorter to start from here.
-          segment.polyline_.clear();
-        }
-
-        segment.polyline_.emplace_back(coord);
-        if (w.node_to_osm_[r.way_nodes_[way][to_idx]] == osm_idx) {
-          break;
-        }
-      }
+    w.way_node_polyline(way, std::min(from_idx, to_idx),
+                        std::max(from_idx, to_idx), segment.polyline_);
+    if (from_idx > to_idx) {
+      std::reverse(begin(segment.polyline_), end(segment.polyline_));
     }
   } else {
     segment.from_level_ = level_t{0.0F};
@@ -172,8 +170,10 @@ path reconstruct(ways const& w,
     if (pred.has_value()) {
       auto const expected_cost =
           static_cast<cost_t>(e.cost(n) - d.get_cost(*pred));
-      dist += add_path<Profile>(w, *w.r_, blocked, sharing, *pred, n,
-                                expected_cost, segments, dir);
+      auto const conn = get_connecting_way<Profile>(
+          w, blocked, sharing, e, *pred, n, expected_cost, dir);
+      dist += add_path<Profile>(w, *w.r_, *pred, n, conn, expected_cost,
+                                segments);
     } else {
       break;
     }
@@ -289,11 +289,13 @@ std::optional<path> route(ways const& w,
                           cost_t const max,
                           direction const dir,
                           bitvec<node_idx_t> const* blocked,
-                          sharing_data const* sharing) {
+                          sharing_data const* sharing,
+                          cancel_token const* cancel) {
   if (auto const direct = try_direct(from, to); direct.has_value()) {
     return *direct;
   }
 
+  auto const search_start = search_clock::now();
   d.reset(max);
 
   for (auto const& start : from_match) {
@@ -309,13 +311,19 @@ std::optional<path> route(ways const& w,
       continue;
     }
 
-    d.run(w, *w.r_, max, blocked, sharing, dir);
+    d.run(w, *w.r_, max, blocked, sharing, dir, cancel);
 
     auto const c = best_candidate(w, d, to.lvl_, to_match, max, dir);
     if (c.has_value()) {
       auto const [nc, wc, node, p] = *c;
-      return reconstruct<Profile>(w, blocked, sharing, d, start, *nc, node,
-                                  p.cost_, dir);
+      auto const reconstruct_start = search_clock::now();
+      auto result = reconstruct<Profile>(w, blocked, sharing, d, start, *nc,
+                                         node, p.cost_, dir);
+      result.stats_ = d.stats_;
+      result.stats_.search_time_ = std::chrono::duration_cast<
+          search_stats::duration_t>(reconstruct_start - search_start);
+      result.stats_.reconstruct_time_ = elapsed_since(reconstruct_start);
+      return result;
     }
   }
 
@@ -334,7 +342,8 @@ std::vector<std::optional<path>> route(
     direction const dir,
     bitvec<node_idx_t> const* blocked,
     sharing_data const* sharing,
-    std::function<bool(path const&)> const& do_reconstruct) {
+    std::function<bool(path const&)> const& do_reconstruct,
+    cancel_token const* cancel) {
   auto result = std::vector<std::optional<path>>{};
   result.resize(to_match.size());
 
@@ -342,6 +351,21 @@ std::vector<std::optional<path>> route(
     return result;
   }
 
+  auto const search_start = search_clock::now();
+  auto reconstruct_time = search_stats::duration_t{};
+  auto const finish = [&]() {
+    auto const search_time = elapsed_since(search_start) - reconstruct_time;
+    for (auto& r : result) {
+      if (r.has_value()) {
+        auto const path_reconstruct_time = r->stats_.reconstruct_time_;
+        r->stats_ = d.stats_;
+        r->stats_.search_time_ = search_time;
+        r->stats_.reconstruct_time_ = path_reconstruct_time;
+      }
+    }
+    return std::move(result);
+  };
+
   d.reset(max);
   for (auto const& start : from_match) {
     for (auto const* nc : {&start.left_, &start.right_}) {
@@ -355,7 +379,7 @@ std::vector<std::optional<path>> route(
       }
     }
 
-    d.run(w, *w.r_, max, blocked, sharing, dir);
+    d.run(w, *w.r_, max, blocked, sharing, dir, cancel);
 
     auto found = 0U;
     for (auto const [m, t, r] : utl::zip(to_match, to, result)) {
@@ -369,9 +393,12 @@ std::vector<std::optional<path>> route(
           auto [nc, wc, n, p] = *c;
           d.cost_.at(n.get_key()).write(n, p);
           if (do_reconstruct(p)) {
+            auto const reconstruct_start = search_clock::now();
             p = reconstruct<Profile>(w, blocked, sharing, d, start, *nc, n,
                                      p.cost_, dir);
             p.uses_elevator_ = true;
+            p.stats_.reconstruct_time_ = elapsed_since(reconstruct_start);
+            reconstruct_time += p.stats_.reconstruct_time_;
           }
           r = std::make_optional(p);
           ++found;
@@ -380,11 +407,11 @@ std::vector<std::optional<path>> route(
     }
 
     if (found == result.size()) {
-      return result;
+      return finish();
     }
   }
 
-  return result;
+  return finish();
 }
 
 std::vector<std::optional<path>> route(
@@ -398,9 +425,11 @@ std::vector<std::optional<path>> route(
     double const max_match_distance,
     bitvec<node_idx_t> const* blocked,
     sharing_data const* sharing,
-    std::function<bool(path const&)> const& do_reconstruct) {
+    std::function<bool(path const&)> const& do_reconstruct,
+    cancel_token const* cancel) {
   auto const r = [&]<typename Profile>(
                      dijkstra<Profile>& d) -> std::vector<std::optional<path>> {
+    auto const match_start = search_clock::now();
     auto const from_match =
         l.match<Profile>(from, false, dir, max_match_distance, blocked);
     if (from_match.empty()) {
@@ -409,8 +438,15 @@ std::vector<std::optional<path>> route(
     auto const to_match = utl::to_vec(to, [&](auto&& x) {
       return l.match<Profile>(x, true, dir, max_match_distance, blocked);
     });
-    return route(w, d, from, to, from_match, to_match, max, dir, blocked,
-                 sharing, do_reconstruct);
+    auto const match_time = elapsed_since(match_start);
+    auto result = route(w, d, from, to, from_match, to_match, max, dir,
+                        blocked, sharing, do_reconstruct, cancel);
+    for (auto& p : result) {
+      if (p.has_value()) {
+        p->stats_.match_time_ = match_time;
+      }
+    }
+    return result;
   };
 
   switch (profile) {
@@ -439,20 +475,27 @@ std::optional<path> route(ways const& w,
                           direction const dir,
                           double const max_match_distance,
                           bitvec<node_idx_t> const* blocked,
-                          sharing_data const* sharing) {
+                          sharing_data const* sharing,
+                          cancel_token const* cancel) {
   auto const r =
       [&]<typename Profile>(dijkstra<Profile>& d) -> std::optional<path> {
+    auto const match_start = search_clock::now();
     auto const from_match =
         l.match<Profile>(from, false, dir, max_match_distance, blocked);
     auto const to_match =
         l.match<Profile>(to, true, dir, max_match_distance, blocked);
+    auto const match_time = elapsed_since(match_start);
 
     if (from_match.empty() || to_match.empty()) {
       return std::nullopt;
     }
 
-    return route(w, d, from, to, from_match, to_match, max, dir, blocked,
-                 sharing);
+    auto p = route(w, d, from, to, from_match, to_match, max, dir, blocked,
+                   sharing, cancel);
+    if (p.has_value()) {
+      p->stats_.match_time_ = match_time;
+    }
+    return p;
   };
 
   switch (profile) {
@@ -483,7 +526,8 @@ std::vector<std::optional<path>> route(
     direction const dir,
     bitvec<node_idx_t> const* blocked,
     sharing_data const* sharing,
-    std::function<bool(path const&)> const& do_reconstruct) {
+    std::function<bool(path const&)> const& do_reconstruct,
+    cancel_token const* cancel) {
   if (from_match.empty()) {
     return std::vector<std::optional<path>>(to.size());
   }
@@ -491,7 +535,7 @@ std::vector<std::optional<path>> route(
   auto const r = [&]<typename Profile>(
                      dijkstra<Profile>& d) -> std::vector<std::optional<path>> {
     return route(w, d, from, to, from_match, to_match, max, dir, blocked,
-                 sharing, do_reconstruct);
+                 sharing, do_reconstruct, cancel);
   };
 
   switch (profile) {
@@ -520,7 +564,8 @@ std::optional<path> route(ways const& w,
                           cost_t const max,
                           direction const dir,
                           bitvec<node_idx_t> const* blocked,
-                          sharing_data const* sharing) {
+                          sharing_data const* sharing,
+                          cancel_token const* cancel) {
   if (from_match.empty() || to_match.empty()) {
     return std::nullopt;
   }
@@ -528,7 +573,7 @@ std::optional<path> route(ways const& w,
   auto const r =
       [&]<typename Profile>(dijkstra<Profile>& d) -> std::optional<path> {
     return route(w, d, from, to, from_match, to_match, max, dir, blocked,
-                 sharing);
+                 sharing, cancel);
   };
 
   switch (profile) {
@@ -0,0 +1,346 @@
+#include "osr/extract/synthetic.h"
+
+#include <array>
+#include <cmath>
+#include <limits>
+#include <numbers>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "fmt/core.h"
+
+#include "osmium/builder/osm_object_builder.hpp"
+#include "osmium/io/any_output.hpp"
+#include "osmium/memory/buffer.hpp"
+
+#include "cista/hash.h"
+
+#include "utl/verify.h"
+
+namespace osr {
+
+namespace {
+
+constexpr auto const kBufferSize = std::size_t{16U} * 1024U * 1024U;
+constexpr auto const kMetersPerDegree = 111'320.0;
+
+enum salt : std::uint64_t {
+  kRowSegment,
+  kColSegment,
+  kRowOneway,
+  kColOneway,
+  kBuilding,
+  kRestriction,
+  kPlatform
+};
+
+struct generator {
+  generator(synthetic_options const& opt, std::filesystem::path const& out)
+      : opt_{opt},
+        dlat_{opt.spacing_ / kMetersPerDegree},
+        dlng_{opt.spacing_ /
+              (kMetersPerDegree *
+               std::cos(opt.origin_lat_ * std::numbers::pi / 180.0))},
+        writer_{osmium::io::File{out.generic_string()},
+                osmium::io::overwrite::allow} {}
+
+  std::uint64_t hash(salt const s, std::uint64_t const a) const {
+    return cista::hash_combine(cista::BASE_HASH, opt_.seed_,
+                               static_cast<std::uint64_t>(s), a);
+  }
+
+  bool chance(double const p, salt const s, std::uint64_t const a) const {
+    return static_cast<double>(hash(s, a)) <
+           p * static_cast<double>(std::numeric_limits<std::uint64_t>::max());
+  }
+
+  // --- grid ---
+  std::int64_t grid_node(std::uint32_t const r, std::uint32_t const c) const {
+    return 1 + static_cast<std::int64_t>(r) * opt_.n_cols_ + c;
+  }
+
+  osmium::Location grid_pos(double const r, double const c) const {
+    return {opt_.origin_lng_ + c * dlng_, opt_.origin_lat_ + r * dlat_};
+  }
+
+  // Segment (r, c) -> (r, c + 1) resp. (r, c) -> (r + 1, c).
+  bool has_segment(bool const is_row,
+                   std::uint32_t const line,
+                   std::uint32_t const i) const {
+    auto const n = is_row ? opt_.n_cols_ : opt_.n_rows_;
+    return i + 1U < n &&
+           !chance(opt_.delete_probability_,
+                   is_row ? kRowSegment : kColSegment,
+                   static_cast<std::uint64_t>(line) * n + i);
+  }
+
+  std::int64_t line_way_id(bool const is_row,
+                           std::uint32_t const line,
+                           std::uint32_t const start) const {
+    auto const n = is_row ? opt_.n_cols_ : opt_.n_rows_;
+    return 2 * (static_cast<std::int64_t>(line) * n + start) +
+           (is_row ? 1 : 2);
+  }
+
+  // Way of the row/column `line` that contains position i (if any).
+  std::optional<std::int64_t> find_line_way(bool const is_row,
+                                            std::uint32_t const line,
+                                            std::uint32_t const i) const {
+    if (!has_segment(is_row, line, i) &&
+        (i == 0U || !has_segment(is_row, line, i - 1U))) {
+      return std::nullopt;
+    }
+    auto start = i;
+    while (start != 0U && has_segment(is_row, line, start - 1U)) {
+      --start;
+    }
+    return line_way_id(is_row, line, start);
+  }
+
+  char const* road_class(std::uint32_t const line) const {
+    if (opt_.primary_every_ != 0U && line % opt_.primary_every_ == 0U) {
+      return "primary";
+    } else if (opt_.secondary_every_ != 0U &&
+               line % opt_.secondary_every_ == 0U) {
+      return "secondary";
+    }
+    return "residential";
+  }
+
+  // --- buildings ---
+  std::int64_t nodes_per_building() const { return opt_.n_levels_ * 4 + 1; }
+
+  std::int64_t building_node(std::uint32_t const b,
+                             std::uint32_t const level,
+                             std::uint32_t const corner) const {
+    return 1 + static_cast<std::int64_t>(opt_.n_rows_) * opt_.n_cols_ +
+           static_cast<std::int64_t>(b) * nodes_per_building() + level * 4 +
+           corner;
+  }
+
+  std::int64_t elevator_node(std::uint32_t const b) const {
+    return building_node(b, opt_.n_levels_, 0U);
+  }
+
+  std::int64_t building_way(std::uint32_t const b,
+                            std::uint32_t const level,
+                            std::uint32_t const i) const {
+    return 2 * static_cast<std::int64_t>(opt_.n_rows_) * opt_.n_cols_ + 3 +
+           (static_cast<std::int64_t>(b) * opt_.n_levels_ + level) * 3 + i;
+  }
+
+  std::pair<std::uint32_t, std::uint32_t> building_cell(
+      std::uint32_t const b) const {
+    auto const h = hash(kBuilding, b);
+    return {static_cast<std::uint32_t>(h % (opt_.n_rows_ - 1U)),
+            static_cast<std::uint32_t>((h >> 32U) % (opt_.n_cols_ - 1U))};
+  }
+
+  // --- output ---
+  void flush(bool const force = false) {
+    if (force || buf_.committed() > kBufferSize - kBufferSize / 8U) {
+      writer_(std::move(buf_));
+      buf_ = osmium::memory::Buffer{kBufferSize,
+                                    osmium::memory::Buffer::auto_grow::yes};
+    }
+  }
+
+  template <typename... Tags>
+  void node(std::int64_t const id, osmium::Location const pos, Tags... tags) {
+    {
+      auto b = osmium::builder::NodeBuilder{buf_};
+      b.set_id(id).set_version(1).set_location(pos);
+      auto t = osmium::builder::TagListBuilder{b};
+      (t.add_tag(tags.first, tags.second), ...);
+    }
+    buf_.commit();
+    flush();
+  }
+
+  template <typename Nodes, typename... Tags>
+  void way(std::int64_t const id, Nodes const& nodes, Tags... tags) {
+    {
+      auto b = osmium::builder::WayBuilder{buf_};
+      b.set_id(id).set_version(1);
+      {
+        auto n = osmium::builder::WayNodeListBuilder{b};
+        for (auto const x : nodes) {
+          n.add_node_ref(osmium::NodeRef{x});
+        }
+      }
+      auto t = osmium::builder::TagListBuilder{b};
+      (t.add_tag(tags.first, tags.second), ...);
+    }
+    buf_.commit();
+    flush();
+  }
+
+  void restriction(std::int64_t const id,
+                   std::int64_t const from,
+                   std::int64_t const via,
+                   std::int64_t const to) {
+    {
+      auto b = osmium::builder::RelationBuilder{buf_};
+      b.set_id(id).set_version(1);
+      {
+        auto m = osmium::builder::RelationMemberListBuilder{b};
+        m.add_member(osmium::item_type::way, from, "from");
+        m.add_member(osmium::item_type::node, via, "via");
+        m.add_member(osmium::item_type::way, to, "to");
+      }
+      auto t = osmium::builder::TagListBuilder{b};
+      t.add_tag("type", "restriction");
+      t.add_tag("restriction", "no_left_turn");
+    }
+    buf_.commit();
+    flush();
+  }
+
+  void write_nodes() {
+    for (auto r = 0U; r != opt_.n_rows_; ++r) {
+      for (auto c = 0U; c != opt_.n_cols_; ++c) {
+        auto const id = grid_node(r, c);
+        if (chance(opt_.platform_probability_, kPlatform,
+                   static_cast<std::uint64_t>(id))) {
+          auto const name = fmt::format("Stop {}", id);
+          node(id, grid_pos(r, c), std::pair{"highway", "bus_stop"},
+               std::pair{"public_transport", "platform"},
+               std::pair{"name", name.c_str()});
+        } else {
+          node(id, grid_pos(r, c));
+        }
+      }
+    }
+
+    auto all_levels = std::string{"0"};
+    for (auto l = 1U; l != opt_.n_levels_; ++l) {
+      all_levels += fmt::format(";{}", l);
+    }
+    for (auto b = 0U; b != opt_.n_buildings_; ++b) {
+      auto const [r, c] = building_cell(b);
+      constexpr auto const kCorners =
+          std::array<std::pair<double, double>, 4U>{
+              {{0.3, 0.3}, {0.3, 0.7}, {0.7, 0.7}, {0.7, 0.3}}};
+      for (auto l = 0U; l != opt_.n_levels_; ++l) {
+        for (auto i = 0U; i != kCorners.size(); ++i) {
+          node(building_node(b, l, i),
+               grid_pos(r + kCorners[i].first, c + kCorners[i].second));
+        }
+      }
+      node(elevator_node(b), grid_pos(r + 0.5, c + 0.5),
+           std::pair{"highway", "elevator"},
+           std::pair{"level", all_levels.c_str()});
+    }
+  }
+
+  void write_line_ways(bool const is_row) {
+    auto const n_lines = is_row ? opt_.n_rows_ : opt_.n_cols_;
+    auto const n = is_row ? opt_.n_cols_ : opt_.n_rows_;
+    auto nodes = std::vector<std::int64_t>{};
+    for (auto line = 0U; line != n_lines; ++line) {
+      auto const highway = road_class(line);
+      auto start = 0U;
+      for (auto i = 0U; i != n; ++i) {
+        if (has_segment(is_row, line, i)) {
+          continue;
+        }
+        if (i != start) {  // run start..i has at least one segment
+          nodes.clear();
+          for (auto j = start; j <= i; ++j) {
+            nodes.push_back(is_row ? grid_node(line, j) : grid_node(j, line));
+          }
+          auto const id = line_way_id(is_row, line, start);
+          auto const oneway =
+              highway == std::string_view{"residential"} &&
+              chance(opt_.oneway_probability_, is_row ? kRowOneway : kColOneway,
+                     static_cast<std::uint64_t>(id));
+          if (oneway) {
+            way(id, nodes, std::pair{"highway", highway},
+                std::pair{"oneway", "yes"});
+          } else {
+            way(id, nodes, std::pair{"highway", highway});
+          }
+        }
+        start = i + 1U;
+      }
+    }
+  }
+
+  void write_building_ways() {
+    for (auto b = 0U; b != opt_.n_buildings_; ++b) {
+      auto const [r, c] = building_cell(b);
+      for (auto l = 0U; l != opt_.n_levels_; ++l) {
+        auto const level = std::to_string(l);
+        auto const corner = [&](std::uint32_t const i) {
+          return building_node(b, l, i);
+        };
+
+        way(building_way(b, l, 0U),
+            std::array{corner(0U), corner(1U), corner(2U), corner(3U),
+                       corner(0U)},
+            std::pair{"highway", "footway"},
+            std::pair{"level", level.c_str()});
+        way(building_way(b, l, 1U), std::array{corner(2U), elevator_node(b)},
+            std::pair{"highway", "footway"},
+            std::pair{"level", level.c_str()});
+
+        if (l + 1U != opt_.n_levels_) {
+          auto const levels = fmt::format("{};{}", l, l + 1U);
+          way(building_way(b, l, 2U),
+              std::array{corner(1U), building_node(b, l + 1U, 1U)},
+              std::pair{"highway", "steps"},
+              std::pair{"level", levels.c_str()});
+        } else {
+          way(building_way(b, l, 2U),
+              std::array{grid_node(r, c), building_node(b, 0U, 0U)},
+              std::pair{"highway", "footway"}, std::pair{"level", "0"});
+        }
+      }
+    }
+  }
+
+  void write_restrictions() {
+    for (auto i = 0U; i != opt_.n_restrictions_; ++i) {
+      auto const h = hash(kRestriction, i);
+      auto const r = static_cast<std::uint32_t>(h % opt_.n_rows_);
+      auto const c = static_cast<std::uint32_t>((h >> 32U) % opt_.n_cols_);
+      auto const from = find_line_way(true, r, c);
+      auto const to = find_line_way(false, c, r);
+      if (from.has_value() && to.has_value()) {
+        restriction(i + 1, *from, grid_node(r, c), *to);
+      }
+    }
+  }
+
+  void write() {
+    write_nodes();
+    write_line_ways(true);
+    write_line_ways(false);
+    write_building_ways();
+    write_restrictions();
+    flush(true);
+    writer_.close();
+  }
+
+  synthetic_options const& opt_;
+  double dlat_, dlng_;
+  osmium::io::Writer writer_;
+  osmium::memory::Buffer buf_{kBufferSize,
+                              osmium::memory::Buffer::auto_grow::yes};
+};
+
+}  // namespace
+
+void write_synthetic_osm(synthetic_options const& opt,
+                         std::filesystem::path const& out) {
+  utl::verify(opt.n_rows_ >= 2U && opt.n_cols_ >= 2U,
+              "synthetic: at least 2x2 intersections required");
+  utl::verify(opt.n_levels_ >= 1U && opt.n_levels_ <= 4U,
+              "synthetic: 1-4 building levels supported");
+  generator{opt, out}.write();
+}
+
+}  // namespace osr
@@ -0,0 +1,324 @@
+#include "osr/extract/update.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <ranges>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "oneapi/tbb/blocked_range.h"
+#include "oneapi/tbb/parallel_for.h"
+
+#include "osmium/io/gzip_compression.hpp"
+#include "osmium/io/reader.hpp"
+#include "osmium/io/xml_input.hpp"
+#include "osmium/memory/buffer.hpp"
+#include "osmium/osm/node.hpp"
+#include "osmium/osm/relation.hpp"
+#include "osmium/osm/way.hpp"
+
+#include "utl/helpers/algorithm.h"
+#include "utl/zip.h"
+
+#include "osr/extract/properties.h"
+#include "osr/extract/tags.h"
+#include "osr/lookup.h"
+#include "osr/util/multi_counter.h"
+#include "osr/ways.h"
+
+using namespace std::string_view_literals;
+
+namespace osr {
+
+namespace {
+
+// Last version of every object in the change file. Pointers point into
+// buffers_, which is kept alive until the update is done.
+struct changes {
+  explicit changes(std::filesystem::path const& osc) {
+    auto reader = osmium::io::Reader{osmium::io::File{osc.generic_string()},
+                                     osmium::io::read_meta::yes};
+    while (auto buf = reader.read()) {
+      auto const& b = buffers_.emplace_back(std::move(buf));
+      for (auto const& n : b.select<osmium::Node>()) {
+        nodes_[osm_node_idx_t{n.positive_id()}] = &n;
+      }
+      for (auto const& w : b.select<osmium::Way>()) {
+        ways_[osm_way_idx_t{w.positive_id()}] = &w;
+      }
+      for (auto const& r : b.select<osmium::Relation>()) {
+        relations_.push_back(&r);
+      }
+    }
+    reader.close();
+  }
+
+  std::vector<osmium::memory::Buffer> buffers_;
+  std::map<osm_node_idx_t, osmium::Node const*> nodes_;
+  std::map<osm_way_idx_t, osmium::Way const*> ways_;
+  std::vector<osmium::Relation const*> relations_;
+};
+
+struct way_change {
+  way_idx_t way_;
+  way_properties p_;
+  std::string_view name_;
+  bool deleted_;
+};
+
+struct node_change {
+  node_idx_t node_;
+  node_properties p_;
+};
+
+struct point_change {
+  way_idx_t way_;
+  std::uint16_t polyline_idx_;
+  point pos_;
+};
+
+template <typename T>
+bool bytes_equal(T const& a, T const& b) {
+  return std::memcmp(&a, &b, sizeof(T)) == 0;
+}
+
+// Nodes with these properties have to be graph nodes (see extract).
+bool needs_graph_node(tags const& t, node_properties const p) {
+  return !p.is_car_accessible() || !p.is_bike_accessible() ||
+         !p.is_walk_accessible() || t.is_elevator_ || t.is_platform_;
+}
+
+void update_way_node_dist(ways& w,
+                          way_idx_t const way,
+                          std::vector<point> const& polyline) {
+  auto const offsets = w.way_node_polyline_idx_[way];
+  auto dist = w.r_->way_node_dist_[way];
+  for (auto i = 1U; i < offsets.size(); ++i) {
+    auto d = 0.0;
+    for (auto j = offsets[i - 1U] + 1U; j <= offsets[i]; ++j) {
+      d += geo::distance(polyline[j], polyline[j - 1U]);
+    }
+    dist[i - 1U] = static_cast<std::uint16_t>(std::round(d));
+  }
+}
+
+}  // namespace
+
+update_stats update(std::filesystem::path const& osc,
+                    std::filesystem::path const& data) {
+  auto const c = changes{osc};
+  auto w = ways{data, cista::mmap::protection::MODIFY};
+  auto s = update_stats{};
+
+  // Ways: tags and deletions.
+  auto way_changes = std::vector<way_change>{};
+  for (auto const& [osm_way_idx, x] : c.ways_) {
+    auto const way = w.find_way(osm_way_idx);
+    if (!x->visible()) {
+      if (way.has_value()) {
+        auto p = w.r_->way_properties_[*way];
+        p.is_foot_accessible_ = false;
+        p.is_bike_accessible_ = false;
+        p.is_car_accessible_ = false;
+        way_changes.push_back({*way, p, {}, true});
+      }
+      continue;
+    }
+
+    auto const t = tags{*x};
+    auto const routable =
+        !t.highway_.empty() || t.is_platform_ || t.is_parking_;
+    if (!way.has_value()) {
+      if (routable && get_way_properties(t).is_accessible()) {
+        ++s.n_new_ways_;
+      }
+      continue;
+    }
+
+    auto const same_nodes = std::ranges::equal(
+        x->nodes() | std::views::transform([](osmium::NodeRef const& n) {
+          return osm_node_idx_t{n.positive_ref()};
+        }),
+        w.way_osm_nodes(*way));
+    if (!same_nodes || t.is_elevator_) {
+      ++s.n_topology_changes_;
+      continue;
+    }
+
+    if (!routable) {
+      // Either properties from a relation (unknown here) or a way that is
+      // not routable anymore: only a full extract can tell.
+      ++s.n_topology_changes_;
+      continue;
+    }
+
+    auto const p = get_way_properties(t);
+    auto const& old = w.r_->way_properties_[*way];
+    if (!t.has_level_ && (old.from_level_ != p.from_level_ ||
+                          old.to_level_ != p.to_level_)) {
+      ++s.n_relation_changes_;  // levels may come from a relation
+      continue;
+    }
+
+    way_changes.push_back(
+        {*way, p, t.name_.empty() ? t.ref_ : t.name_, false});
+  }
+
+  // Relations: restrictions and relation based way properties.
+  for (auto const* r : c.relations_) {
+    auto const type = r->tags()["type"];
+    if ((type != nullptr && type == "restriction"sv) ||
+        get_way_properties(tags{*r}).is_accessible()) {
+      ++s.n_relation_changes_;
+    }
+  }
+
+  // Nodes: properties of graph nodes, new graph nodes.
+  auto diff_nodes = multi_counter{};
+  auto new_graph_nodes = multi_counter{};
+  auto node_changes = std::vector<node_change>{};
+  for (auto const& [osm_node_idx, n] : c.nodes_) {
+    if (!n->visible()) {
+      continue;  // ways referencing it have to change as well
+    }
+    diff_nodes.increment(to_idx(osm_node_idx));
+
+    auto const t = tags{*n};
+    auto const p = get_node_properties(t).first;
+    auto const node = w.find_node_idx(osm_node_idx);
+    if (!node.has_value()) {
+      if (needs_graph_node(t, p)) {
+        new_graph_nodes.increment(to_idx(osm_node_idx));
+      }
+      continue;
+    }
+
+    auto const& old = w.r_->node_properties_[*node];
+    if (bytes_equal(old, p)) {
+      continue;
+    }
+    if (old.is_elevator() || p.is_elevator()) {
+      ++s.n_node_changes_;  // may come from elevator ways
+      continue;
+    }
+    node_changes.push_back({*node, p});
+  }
+
+  // Geometry: find ways referencing changed nodes.
+  auto touched = std::vector<std::uint8_t>(w.n_ways(), 0U);
+  oneapi::tbb::parallel_for(
+      oneapi::tbb::blocked_range<way_idx_t::value_t>{0U, w.n_ways()},
+      [&](oneapi::tbb::blocked_range<way_idx_t::value_t> const& r) {
+        for (auto i = r.begin(); i != r.end(); ++i) {
+          touched[i] = utl::any_of(
+              w.way_osm_nodes(way_idx_t{i}), [&](osm_node_idx_t const n) {
+                return diff_nodes.contains(to_idx(n));
+              });
+        }
+      });
+
+  auto point_changes = std::vector<point_change>{};
+  auto moved = multi_counter{};
+  for (auto way = way_idx_t{0U}; way != w.n_ways(); ++way) {
+    if (!touched[to_idx(way)]) {
+      continue;
+    }
+    auto const osm_nodes = w.way_osm_nodes(way);
+    auto const polyline = w.way_polyline(way);
+    auto polyline_idx = std::uint16_t{0U};
+    for (auto const [osm_node_idx, pos] : utl::zip(osm_nodes, polyline)) {
+      if (diff_nodes.contains(to_idx(osm_node_idx))) {
+        if (new_graph_nodes.contains(to_idx(osm_node_idx))) {
+          ++s.n_node_changes_;
+        }
+        auto const new_pos =
+            point::from_location(c.nodes_.at(osm_node_idx)->location());
+        if (new_pos.lat_ != pos.lat_ || new_pos.lng_ != pos.lng_) {
+          point_changes.push_back({way, polyline_idx, new_pos});
+          moved.increment(to_idx(osm_node_idx));
+        }
+      }
+      ++polyline_idx;
+    }
+  }
+
+  if (s.requires_full_extract()) {
+    return s;
+  }
+
+  // Apply.
+  auto l = lookup{w, data, cista::mmap::protection::MODIFY};
+  auto deleted = std::vector<way_idx_t>{};
+  for (auto const& x : way_changes) {
+    if (x.deleted_) {
+      l.remove_way(x.way_, l.get_way_bbox(x.way_));
+      deleted.push_back(x.way_);
+      ++s.n_deleted_ways_;
+    }
+
+    auto& p = w.r_->way_properties_[x.way_];
+    if (!x.deleted_ && !bytes_equal(p, x.p_)) {
+      ++s.n_way_properties_;
+    }
+    p = x.p_;
+
+    // Renamed ways append their new name, strings are not deduplicated.
+    auto const old_name = w.way_names_[x.way_];
+    auto const old_name_str = old_name == string_idx_t::invalid()
+                                  ? std::string_view{}
+                                  : w.strings_[old_name].view();
+    if (!x.deleted_ && old_name_str != x.name_) {
+      auto name = string_idx_t::invalid();
+      if (!x.name_.empty()) {
+        name = string_idx_t{w.strings_.size()};
+        w.strings_.emplace_back(x.name_);
+      }
+      w.way_names_[x.way_] = name;
+    }
+  }
+  utl::sort(deleted);
+
+  for (auto const& x : node_changes) {
+    w.r_->node_properties_[x.node_] = x.p_;
+    ++s.n_node_properties_;
+  }
+
+  utl::sort(point_changes, [](point_change const& a, point_change const& b) {
+    return a.way_ < b.way_;
+  });
+  auto geometries = std::vector<std::pair<way_idx_t, std::vector<point>>>{};
+  auto old_bboxes = std::vector<geo::box>{};
+  for (auto it = begin(point_changes); it != end(point_changes);) {
+    auto const way = it->way_;
+    auto polyline = w.way_polyline(way);
+    for (; it != end(point_changes) && it->way_ == way; ++it) {
+      polyline[it->polyline_idx_] = it->pos_;
+    }
+    old_bboxes.push_back(l.get_way_bbox(way));
+    geometries.emplace_back(way, std::move(polyline));
+  }
+  w.set_way_polylines(geometries);
+  for (auto const [g, old_bbox] : utl::zip(geometries, old_bboxes)) {
+    auto const& [way, polyline] = g;
+    update_way_node_dist(w, way, polyline);
+    if (!std::binary_search(begin(deleted), end(deleted), way)) {
+      l.remove_way(way, old_bbox);
+      l.insert_way(way);
+    }
+    ++s.n_geometries_;
+  }
+  for (auto const& [osm_node_idx, _] : c.nodes_) {
+    s.n_moved_nodes_ += moved.contains(to_idx(osm_node_idx)) ? 1U : 0U;
+  }
+
+  w.r_->write(data);
+  w.sync();
+  l.write_rtree_meta();
+
+  return s;
+}
+
+}  // namespace osr
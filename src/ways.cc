@@ -1,24 +1,53 @@
 #include "osr/ways.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "oneapi/tbb/blocked_range.h"
+#include "oneapi/tbb/parallel_for.h"
+
 #include "cista/io.h"
 
+#include "osr/util/delta_varint.h"
+
 namespace osr {
 
+namespace {
+
+constexpr auto const kGrainSize = std::size_t{4096U};
+
+}  // namespace
+
 ways::ways(std::filesystem::path p, cista::mmap::protection const mode)
     : p_{std::move(p)},
       mode_{mode},
-      r_{mode == cista::mmap::protection::READ
-             ? routing::read(p_)
-             : cista::wrapped<routing>{cista::raw::make_unique<routing>()}},
+      r_{mode == cista::mmap::protection::WRITE
+             ? cista::wrapped<routing>{cista::raw::make_unique<routing>()}
+             : routing::read(p_)},
       node_to_osm_{mm("node_to_osm.bin")},
       way_osm_idx_{mm("way_osm_idx.bin")},
       way_polylines_{mm_vec<point>{mm("way_polylines_data.bin")},
                      mm_vec<std::uint64_t>{mm("way_polylines_index.bin")}},
       way_osm_nodes_{mm_vec<osm_node_idx_t>{mm("way_osm_nodes_data.bin")},
                      mm_vec<std::uint64_t>{mm("way_osm_nodes_index.bin")}},
+      way_node_polyline_idx_{
+          mm_vec<std::uint16_t>{mm("way_node_polyline_idx_data.bin")},
+          mm_vec<std::uint64_t>{mm("way_node_polyline_idx_index.bin")}},
       strings_{mm_vec<char>(mm("strings_data.bin")),
                mm_vec<std::uint64_t>(mm("strings_idx.bin"))},
-      way_names_{mm("way_names.bin")} {}
+      way_names_{mm("way_names.bin")},
+      way_polylines_packed_{
+          mm_vec<std::uint8_t>{mm("way_polylines_packed_data.bin")},
+          mm_vec<std::uint64_t>{mm("way_polylines_packed_index.bin")}},
+      way_osm_nodes_packed_{
+          mm_vec<std::uint8_t>{mm("way_osm_nodes_packed_data.bin")},
+          mm_vec<std::uint64_t>{mm("way_osm_nodes_packed_index.bin")}} {}
 
 void ways::add_restriction(std::vector<resolved_restriction>& rs) {
   using it_t = std::vector<resolved_restriction>::iterator;
@@ -61,7 +90,7 @@ void ways::connect_ways() {
         .out_bounds(50, 60);
 
     auto node_idx = node_idx_t{0U};
-    node_way_counter_.multi_.for_each_set_bit([&](std::uint64_t const b_idx) {
+    node_way_counter_.for_each_multi([&](std::uint64_t const b_idx) {
       auto const i = osm_node_idx_t{b_idx};
       node_to_osm_.push_back(i);
       ++node_idx;
@@ -70,75 +99,153 @@ void ways::connect_ways() {
     r_->node_is_restricted_.resize(to_idx(node_idx));
   }
 
-  // Build edges.
+  // Build edges. Every phase is parallel over ways (or nodes) and writes
+  // to precomputed positions, so the result does not depend on scheduling.
   {
     pt->status("Connect ways")
-        .in_high(way_osm_nodes_.size())
+        .in_high(way_osm_nodes_.size() * 4U)
         .out_bounds(60, 90);
-    auto node_ways = mm_paged_vecvec<node_idx_t, way_idx_t>{
-        cista::paged<mm_vec32<way_idx_t>>{
-            mm_vec32<way_idx_t>{mm("tmp_node_ways_data.bin")}},
-        mm_vec<cista::page<std::uint32_t, std::uint16_t>>{
-            mm("tmp_node_ways_index.bin")}};
-    auto node_in_way_idx = mm_paged_vecvec<node_idx_t, std::uint16_t>{
-        cista::paged<mm_vec32<std::uint16_t>>{
-            mm_vec32<std::uint16_t>{mm("tmp_node_in_way_idx_data.bin")}},
-        mm_vec<cista::page<std::uint32_t, std::uint16_t>>{
-            mm("tmp_node_in_way_idx_index.bin")}};
-    node_ways.resize(node_to_osm_.size());
-    node_in_way_idx.resize(node_to_osm_.size());
-    for (auto const [osm_way_idx, osm_nodes, polyline] :
-         utl::zip(way_osm_idx_, way_osm_nodes_, way_polylines_)) {
-      auto pred_pos = std::make_optional<point>();
-      auto from = node_idx_t::invalid();
+
+    utl::verify(r_->way_nodes_.empty(), "connect_ways: already connected");
+
+    auto const n_ways = way_osm_nodes_.size();
+    auto const n_nodes = node_to_osm_.size();
+    auto done = std::atomic_size_t{0U};
+    auto const for_each_way = [&](auto&& fn) {
+      oneapi::tbb::parallel_for(
+          oneapi::tbb::blocked_range<std::size_t>{0U, n_ways, kGrainSize},
+          [&](oneapi::tbb::blocked_range<std::size_t> const& r) {
+            for (auto i = r.begin(); i != r.end(); ++i) {
+              fn(way_idx_t{static_cast<way_idx_t::value_t>(i)});
+            }
+            pt->update(done += r.size());
+          });
+    };
+
+    auto& way_nodes = r_->way_nodes_;
+    auto& way_node_dist = r_->way_node_dist_;
+    auto& polyline_idx = way_node_polyline_idx_;
+
+    // Size way_nodes_, way_node_dist_, way_node_polyline_idx_.
+    way_nodes.bucket_starts_.resize(n_ways + 1U);
+    way_nodes.bucket_starts_[0U] = 0U;
+    for_each_way([&](way_idx_t const way) {
+      auto const osm_nodes = way_osm_nodes_[way];
+      way_nodes.bucket_starts_[to_idx(way) + 1U] = static_cast<std::uint32_t>(
+          std::count_if(begin(osm_nodes), end(osm_nodes),
+                        [&](osm_node_idx_t const n) {
+                          return node_way_counter_.is_multi(to_idx(n));
+                        }));
+    });
+    std::partial_sum(begin(way_nodes.bucket_starts_),
+                     end(way_nodes.bucket_starts_),
+                     begin(way_nodes.bucket_starts_));
+
+    way_node_dist.bucket_starts_.resize(n_ways + 1U);
+    polyline_idx.bucket_starts_.resize(n_ways + 1U);
+    way_node_dist.bucket_starts_[0U] = 0U;
+    polyline_idx.bucket_starts_[0U] = 0U;
+    for (auto i = 0U; i != n_ways; ++i) {
+      auto const n = way_nodes.bucket_starts_[i + 1U] -
+                     way_nodes.bucket_starts_[i];
+      way_node_dist.bucket_starts_[i + 1U] =
+          way_node_dist.bucket_starts_[i] + (n == 0U ? 0U : n - 1U);
+      polyline_idx.bucket_starts_[i + 1U] = way_nodes.bucket_starts_[i + 1U];
+    }
+    way_nodes.data_.resize(way_nodes.bucket_starts_.back());
+    way_node_dist.data_.resize(way_node_dist.bucket_starts_.back());
+    polyline_idx.data_.resize(polyline_idx.bucket_starts_.back());
+
+    // Graph nodes, distances and polyline offsets of every way.
+    for_each_way([&](way_idx_t const way) {
+      auto const osm_nodes = way_osm_nodes_[way];
+      auto const polyline = way_polylines_[way];
+      auto pred_pos = std::optional<point>{};
       auto distance = 0.0;
-      auto i = std::uint16_t{0U};
-      auto way_idx = way_idx_t{r_->way_nodes_.size()};
-      auto dists = r_->way_node_dist_.add_back_sized(0U);
-      auto nodes = r_->way_nodes_.add_back_sized(0U);
+      auto j = way_nodes.bucket_starts_[to_idx(way)];
+      auto d = way_node_dist.bucket_starts_[to_idx(way)];
+      auto const first = j;
+      auto polyline_pos = std::uint16_t{0U};
       for (auto const [osm_node_idx, pos] : utl::zip(osm_nodes, polyline)) {
         if (pred_pos.has_value()) {
           distance += geo::distance(pos, *pred_pos);
         }
 
         if (node_way_counter_.is_multi(to_idx(osm_node_idx))) {
-          auto const to = get_node_idx(osm_node_idx);
-          node_ways[to].push_back(way_idx);
-          node_in_way_idx[to].push_back(i);
-          nodes.push_back(to);
-
-          if (from != node_idx_t::invalid()) {
-            dists.push_back(static_cast<std::uint16_t>(std::round(distance)));
+          if (j != first) {
+            way_node_dist.data_[d++] =
+                static_cast<std::uint16_t>(std::round(distance));
           }
-
+          way_nodes.data_[j] = get_node_idx(osm_node_idx);
+          polyline_idx.data_[j] = polyline_pos;
           distance = 0.0;
-          from = to;
 
-          if (i == std::numeric_limits<std::uint16_t>::max()) {
-            fmt::println("error: way with {} nodes", osm_way_idx);
+          if (j - first == std::numeric_limits<std::uint16_t>::max()) {
+            fmt::println("error: way with {} nodes", way_osm_idx_[way]);
           }
 
-          ++i;
+          ++j;
         }
 
         pred_pos = pos;
+        ++polyline_pos;
       }
-      pt->increment();
-    }
+    });
 
-    for (auto const x : node_ways) {
-      r_->node_ways_.emplace_back(x);
+    // node -> ways: count, prefix sum, scatter.
+    auto& node_ways = r_->node_ways_;
+    auto& node_in_way_idx = r_->node_in_way_idx_;
+    node_ways.bucket_starts_.resize(n_nodes + 1U);
+    for (auto& x : node_ways.bucket_starts_) {
+      x = 0U;
     }
-    for (auto const x : node_in_way_idx) {
-      r_->node_in_way_idx_.emplace_back(x);
-    }
-  }
+    for_each_way([&](way_idx_t const way) {
+      for (auto const n : way_nodes[way]) {
+        std::atomic_ref{node_ways.bucket_starts_[to_idx(n) + 1U]}.fetch_add(
+            1U, std::memory_order_relaxed);
+      }
+    });
+    std::partial_sum(begin(node_ways.bucket_starts_),
+                     end(node_ways.bucket_starts_),
+                     begin(node_ways.bucket_starts_));
+    node_in_way_idx.bucket_starts_ = node_ways.bucket_starts_;
+    node_ways.data_.resize(node_ways.bucket_starts_.back());
+    node_in_way_idx.data_.resize(node_ways.bucket_starts_.back());
+
+    auto fill = std::vector<std::uint32_t>(n_nodes);
+    for_each_way([&](way_idx_t const way) {
+      for (auto const [i, n] : utl::enumerate(way_nodes[way])) {
+        auto const pos =
+            node_ways.bucket_starts_[to_idx(n)] +
+            std::atomic_ref{fill[to_idx(n)]}.fetch_add(
+                1U, std::memory_order_relaxed);
+        node_ways.data_[pos] = way;
+        node_in_way_idx.data_[pos] = static_cast<std::uint16_t>(i);
+      }
+    });
 
-  auto e = std::error_code{};
-  std::filesystem::remove(p_ / "tmp_node_ways_data.bin", e);
-  std::filesystem::remove(p_ / "tmp_node_ways_index.bin", e);
-  std::filesystem::remove(p_ / "tmp_node_in_way_idx_data.bin", e);
-  std::filesystem::remove(p_ / "tmp_node_in_way_idx_index.bin", e);
+    // Restore the sequential order: by way, then by position in the way.
+    // Buckets are tiny (node degree), so insertion sort is fine.
+    auto const key = [&](std::uint32_t const i) {
+      return std::pair{node_ways.data_[i], node_in_way_idx.data_[i]};
+    };
+    oneapi::tbb::parallel_for(
+        oneapi::tbb::blocked_range<std::size_t>{0U, n_nodes, kGrainSize},
+        [&](oneapi::tbb::blocked_range<std::size_t> const& r) {
+          for (auto n = r.begin(); n != r.end(); ++n) {
+            auto const from = node_ways.bucket_starts_[n];
+            auto const to = node_ways.bucket_starts_[n + 1U];
+            for (auto a = from + 1U; a < to; ++a) {
+              for (auto b = a; b != from && key(b) < key(b - 1U); --b) {
+                std::swap(node_ways.data_[b], node_ways.data_[b - 1U]);
+                std::swap(node_in_way_idx.data_[b],
+                          node_in_way_idx.data_[b - 1U]);
+              }
+            }
+          }
+        });
+    pt->update(pt->in_high_);
+  }
 }
 
 void ways::sync() {
@@ -148,9 +255,119 @@ void ways::sync() {
   way_polylines_.bucket_starts_.mmap_.sync();
   way_osm_nodes_.data_.mmap_.sync();
   way_osm_nodes_.bucket_starts_.mmap_.sync();
+  way_node_polyline_idx_.data_.mmap_.sync();
+  way_node_polyline_idx_.bucket_starts_.mmap_.sync();
   strings_.data_.mmap_.sync();
   strings_.bucket_starts_.mmap_.sync();
   way_names_.mmap_.sync();
+  way_polylines_packed_.data_.mmap_.sync();
+  way_polylines_packed_.bucket_starts_.mmap_.sync();
+  way_osm_nodes_packed_.data_.mmap_.sync();
+  way_osm_nodes_packed_.bucket_starts_.mmap_.sync();
+}
+
+void ways::pack_geometry() {
+  if (is_packed()) {
+    return;
+  }
+
+  way_polylines_packed_.clear();
+  way_osm_nodes_packed_.clear();
+
+  auto buf = std::vector<std::uint8_t>{};
+  for (auto way = way_idx_t{0U}; way != n_ways(); ++way) {
+    buf.clear();
+    pack_polyline(way_polylines_[way], buf);
+    way_polylines_packed_.emplace_back(buf);
+
+    buf.clear();
+    pack_osm_nodes(way_osm_nodes_[way], buf);
+    way_osm_nodes_packed_.emplace_back(buf);
+  }
+
+  // Closing the memory mapped files truncates them to their content.
+  way_polylines_.clear();
+  way_osm_nodes_.clear();
+}
+
+void ways::set_way_polylines(
+    std::vector<std::pair<way_idx_t, std::vector<point>>> const& changes) {
+  if (changes.empty()) {
+    return;
+  }
+
+  if (!is_packed()) {
+    for (auto const& [way, polyline] : changes) {
+      auto dst = way_polylines_[way];
+      utl::verify(dst.size() == polyline.size(),
+                  "set_way_polylines: size mismatch for way {}", way);
+      for (auto i = 0U; i != polyline.size(); ++i) {
+        dst[i] = polyline[i];
+      }
+    }
+    return;
+  }
+
+  // Varint sizes change with the coordinates: re-append all ways starting
+  // with the first changed one.
+  auto& packed = way_polylines_packed_;
+  auto const first = changes.front().first;
+  auto const start = packed.bucket_starts_[to_idx(first)];
+  auto const tail_starts = std::vector<std::uint64_t>{
+      packed.bucket_starts_.data() + to_idx(first),
+      packed.bucket_starts_.data() + packed.bucket_starts_.size()};
+  auto const tail = std::vector<std::uint8_t>{
+      packed.data_.data() + start, packed.data_.data() + packed.data_.size()};
+  packed.data_.resize(start);
+  packed.bucket_starts_.resize(to_idx(first) + 1U);
+
+  auto buf = std::vector<std::uint8_t>{};
+  auto it = begin(changes);
+  for (auto way = first; way != n_ways(); ++way) {
+    buf.clear();
+    if (it != end(changes) && it->first == way) {
+      pack_polyline(it->second, buf);
+      ++it;
+    } else {
+      auto const i = to_idx(way) - to_idx(first);
+      buf.assign(tail.data() + (tail_starts[i] - start),
+                 tail.data() + (tail_starts[i + 1U] - start));
+    }
+    packed.emplace_back(buf);
+  }
+}
+
+std::vector<point> ways::way_polyline(way_idx_t const way) const {
+  auto polyline = std::vector<point>{};
+  for_each_polyline_point(way,
+                          [&](point const& p) { polyline.push_back(p); });
+  return polyline;
+}
+
+std::vector<osm_node_idx_t> ways::way_osm_nodes(way_idx_t const way) const {
+  auto osm_nodes = std::vector<osm_node_idx_t>{};
+  if (is_packed()) {
+    unpack_osm_nodes(way_osm_nodes_packed(way), osm_nodes);
+  } else {
+    auto const raw = way_osm_nodes_[way];
+    osm_nodes.assign(begin(raw), end(raw));
+  }
+  return osm_nodes;
+}
+
+void ways::way_node_polyline(way_idx_t const way,
+                             std::uint16_t const a,
+                             std::uint16_t const b,
+                             geo::polyline& out) const {
+  if (!is_packed()) {
+    auto const polyline = way_node_polyline(way, a, b);
+    out.insert(end(out), begin(polyline), end(polyline));
+    return;
+  }
+
+  auto const offsets = way_node_polyline_idx_[way];
+  unpack_polyline(way_polyline_packed(way), offsets[a], offsets[b],
+                  [&](point const& p) { out.emplace_back(p.as_latlng()); });
 }
 
 cista::wrapped<ways::routing> ways::routing::read(
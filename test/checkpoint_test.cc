@@ -0,0 +1,64 @@
+#ifdef _WIN32
+#include "windows.h"
+#endif
+
+#include "gtest/gtest.h"
+
+#include <filesystem>
+
+#include "osr/extract/checkpoint.h"
+#include "osr/extract/extract.h"
+#include "osr/extract/synthetic.h"
+#include "osr/ways.h"
+
+namespace fs = std::filesystem;
+using namespace osr;
+
+TEST(checkpoint, resume) {
+  auto const p = fs::path{"/tmp/osr_checkpoint_test"};
+  auto ec = std::error_code{};
+  fs::remove_all(p, ec);
+  fs::create_directories(p / "a", ec);
+  fs::create_directories(p / "b", ec);
+
+  auto const opt = synthetic_options{.n_rows_ = 10U,
+                                     .n_cols_ = 10U,
+                                     .n_buildings_ = 2U,
+                                     .n_restrictions_ = 5U};
+  write_synthetic_osm(opt, p / "synthetic.osm.pbf");
+  osr::extract(false, p / "synthetic.osm.pbf", p / "a");
+
+  auto const run = [&](extract_phase const stop_after) {
+    osr::extract(
+        extract_options{.checkpoint_ = true, .stop_after_ = stop_after},
+        p / "synthetic.osm.pbf", p / "b");
+    auto const c = read_checkpoint(p / "b");
+    ASSERT_TRUE(c.has_value());
+    EXPECT_EQ(stop_after, c->phase_);
+  };
+
+  run(extract_phase::kWays);
+
+  // Crash while connecting ways: mapped files are larger than their content.
+  fs::resize_file(p / "b" / "node_to_osm.bin", 4096U);
+
+  run(extract_phase::kNodeProperties);
+  run(extract_phase::kRtree);
+  run(extract_phase::kRtree);  // up to date
+
+  auto const a = ways{p / "a", cista::mmap::protection::READ};
+  auto const b = ways{p / "b", cista::mmap::protection::READ};
+  ASSERT_EQ(a.n_nodes(), b.n_nodes());
+  ASSERT_EQ(a.n_ways(), b.n_ways());
+  EXPECT_EQ(a.r_->multi_level_elevators_.size(),
+            b.r_->multi_level_elevators_.size());
+  EXPECT_EQ(a.r_->node_restrictions_.data_.size(),
+            b.r_->node_restrictions_.data_.size());
+  EXPECT_EQ(a.r_->way_nodes_.data_.size(), b.r_->way_nodes_.data_.size());
+  for (auto n = node_idx_t{0U}; n != a.n_nodes(); ++n) {
+    EXPECT_EQ(a.node_to_osm_[n], b.node_to_osm_[n]);
+    EXPECT_EQ(a.r_->node_properties_[n].is_elevator(),
+              b.r_->node_properties_[n].is_elevator());
+  }
+  EXPECT_FALSE(fs::exists(p / "b" / "checkpoint_staged_nodes.bin"));
+}
@@ -0,0 +1,121 @@
+#ifdef _WIN32
+#include "windows.h"
+#endif
+
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#include "osr/extract/extract.h"
+#include "osr/extract/synthetic.h"
+#include "osr/lookup.h"
+#include "osr/routing/route.h"
+#include "osr/util/delta_varint.h"
+#include "osr/ways.h"
+
+namespace fs = std::filesystem;
+using namespace osr;
+
+TEST(delta_varint, round_trip) {
+  auto const polyline = std::vector<point>{
+      point{0, 0}, point{-900'000'000, -1'800'000'000},
+      point{900'000'000, 1'800'000'000}, point{900'000'001, 1'799'999'999}};
+  auto const osm_nodes = std::vector<osm_node_idx_t>{
+      osm_node_idx_t{12'000'000'000U}, osm_node_idx_t{12'000'000'001U},
+      osm_node_idx_t{1U}, osm_node_idx_t{0xFFFF'FFFF'FFFFU}};
+
+  auto buf = std::vector<std::uint8_t>{};
+  pack_polyline(polyline, buf);
+  EXPECT_EQ(polyline.size(), packed_size(buf));
+
+  auto decoded = std::vector<point>{};
+  unpack_polyline(buf, decoded);
+  ASSERT_EQ(polyline.size(), decoded.size());
+  for (auto i = 0U; i != polyline.size(); ++i) {
+    EXPECT_EQ(polyline[i].lat_, decoded[i].lat_);
+    EXPECT_EQ(polyline[i].lng_, decoded[i].lng_);
+  }
+
+  decoded.clear();
+  unpack_polyline(buf, 1U, 2U, [&](point const& p) { decoded.push_back(p); });
+  ASSERT_EQ(2U, decoded.size());
+  EXPECT_EQ(polyline[2].lng_, decoded[1].lng_);
+
+  buf.clear();
+  pack_osm_nodes(osm_nodes, buf);
+  auto decoded_nodes = std::vector<osm_node_idx_t>{};
+  unpack_osm_nodes(buf, decoded_nodes);
+  EXPECT_EQ(osm_nodes, decoded_nodes);
+
+  // Neighbouring OSM ids take a single byte.
+  buf.clear();
+  pack_osm_nodes(std::vector{osm_node_idx_t{1000U}, osm_node_idx_t{1001U}},
+                 buf);
+  EXPECT_EQ(1U + 2U + 1U, buf.size());
+}
+
+TEST(delta_varint, packed_ways) {
+  auto const p = fs::path{"/tmp/osr_packed_ways_test"};
+  auto ec = std::error_code{};
+  fs::remove_all(p, ec);
+  fs::create_directories(p / "a", ec);
+  fs::create_directories(p / "b", ec);
+
+  auto const opt = synthetic_options{.n_rows_ = 10U, .n_cols_ = 10U};
+  write_synthetic_osm(opt, p / "synthetic.osm.pbf");
+  osr::extract(false, p / "synthetic.osm.pbf", p / "a");
+  osr::extract(extract_options{.pack_geometry_ = true},
+               p / "synthetic.osm.pbf", p / "b");
+
+  auto const a = ways{p / "a", cista::mmap::protection::READ};
+  auto const b = ways{p / "b", cista::mmap::protection::READ};
+  ASSERT_FALSE(a.is_packed());
+  ASSERT_TRUE(b.is_packed());
+  ASSERT_EQ(a.n_ways(), b.n_ways());
+
+  // The packed geometry replaces the raw one.
+  EXPECT_EQ(0U, b.way_polylines_.size());
+  EXPECT_EQ(0U, b.way_osm_nodes_.size());
+  EXPECT_LT(fs::file_size(p / "b" / "way_polylines_packed_data.bin"),
+            fs::file_size(p / "a" / "way_polylines_data.bin"));
+
+  // Packed and raw geometry slices are the same.
+  for (auto way = way_idx_t{0U}; way != b.n_ways(); ++way) {
+    EXPECT_EQ(a.way_osm_nodes(way), b.way_osm_nodes(way));
+    ASSERT_EQ(a.way_polyline(way).size(), b.way_polyline(way).size());
+    auto const n = static_cast<std::uint16_t>(b.r_->way_nodes_[way].size());
+    for (auto i = std::uint16_t{1U}; i < n; ++i) {
+      auto raw = geo::polyline{};
+      auto packed = geo::polyline{};
+      a.way_node_polyline(way, i - 1U, i, raw);
+      b.way_node_polyline(way, i - 1U, i, packed);
+      EXPECT_EQ(raw, packed);
+    }
+  }
+
+  for (auto n = node_idx_t{0U}; n != b.n_nodes(); ++n) {
+    EXPECT_EQ(a.get_node_pos(n).lat_, b.get_node_pos(n).lat_);
+    EXPECT_EQ(a.get_node_pos(n).lng_, b.get_node_pos(n).lng_);
+  }
+
+  // Matching and path reconstruction give the same result.
+  auto const la = lookup{a, p / "a", cista::mmap::protection::READ};
+  auto const lb = lookup{b, p / "b", cista::mmap::protection::READ};
+  auto const sw = a.find_node_idx(osm_node_idx_t{1U});
+  auto const ne = a.find_node_idx(osm_node_idx_t{opt.n_rows_ * opt.n_cols_});
+  ASSERT_TRUE(sw.has_value() && ne.has_value());
+  auto const from = location{a.get_node_pos(*sw), kNoLevel};
+  auto const to = location{a.get_node_pos(*ne), kNoLevel};
+  auto const pa = route(a, la, search_profile::kFoot, from, to, 3600U,
+                        direction::kForward, 100.0);
+  auto const pb = route(b, lb, search_profile::kFoot, from, to, 3600U,
+                        direction::kForward, 100.0);
+  ASSERT_TRUE(pa.has_value() && pb.has_value());
+  EXPECT_EQ(pa->cost_, pb->cost_);
+  ASSERT_EQ(pa->segments_.size(), pb->segments_.size());
+  for (auto i = 0U; i != pa->segments_.size(); ++i) {
+    EXPECT_EQ(pa->segments_[i].polyline_, pb->segments_[i].polyline_);
+  }
+}
@@ -0,0 +1,20 @@
+#include "gtest/gtest.h"
+
+#include "osr/util/encoded_polyline.h"
+
+using namespace osr;
+
+TEST(osr, encoded_polyline) {
+  auto const polyline =
+      geo::polyline{{38.5, -120.2}, {40.7, -120.95}, {43.252, -126.453}};
+  EXPECT_EQ("_p~iF~ps|U_ulLnnqC_mqNvxq`@", encode_polyline(polyline));
+  EXPECT_EQ("", encode_polyline(geo::polyline{}));
+  EXPECT_EQ("_izlhA~rlgdF", encode_polyline({{38.5, -120.2}}, 6U));
+  EXPECT_EQ("_izlhA~rlgdF_{geC~ywl@_kwzCn`{nI",
+            encode_polyline(polyline, 6U));
+
+  EXPECT_TRUE(is_valid_polyline_precision(6));
+  EXPECT_FALSE(is_valid_polyline_precision(7));
+  EXPECT_FALSE(is_valid_polyline_precision(-5));
+  EXPECT_ANY_THROW(encode_polyline(polyline, 7U));
+}
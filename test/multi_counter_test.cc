@@ -0,0 +1,69 @@
+#include "gtest/gtest.h"
+
+#include <thread>
+#include <vector>
+
+#include "osr/util/multi_counter.h"
+
+using namespace osr;
+
+TEST(multi_counter, sparse) {
+  auto m = multi_counter{};
+  EXPECT_EQ(0U, m.size());
+  EXPECT_FALSE(m.is_multi(42U));
+
+  auto const far = std::uint64_t{12'000'000'000U};
+  m.increment(42U);
+  m.increment(far);
+  m.increment(far);
+  m.increment(7U);
+  m.increment(7U);
+  m.increment(7U);
+
+  EXPECT_FALSE(m.is_multi(42U));
+  EXPECT_TRUE(m.is_multi(7U));
+  EXPECT_TRUE(m.is_multi(far));
+  EXPECT_FALSE(m.is_multi(far + 1U));
+  EXPECT_EQ(far + 1U, m.size());
+
+  // Memory depends on the referenced id blocks, not on the largest id.
+  EXPECT_EQ(2U, m.n_pages());
+
+  auto multi = std::vector<std::uint64_t>{};
+  m.for_each_multi([&](std::uint64_t const i) { multi.push_back(i); });
+  EXPECT_EQ((std::vector<std::uint64_t>{7U, far}), multi);
+}
+
+TEST(multi_counter, concurrent) {
+  constexpr auto const kThreads = 8U;
+  constexpr auto const kN = std::uint64_t{200'000U};
+
+  // Every thread counts all even ids once, odd id i only in thread i % 8.
+  auto m = multi_counter{};
+  auto threads = std::vector<std::thread>{};
+  for (auto t = 0U; t != kThreads; ++t) {
+    threads.emplace_back([&, t]() {
+      for (auto i = std::uint64_t{0U}; i != kN; ++i) {
+        if (i % 2U == 0U || i % kThreads == t) {
+          m.increment(i * 1'000U);
+        }
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  auto n_multi = std::uint64_t{0U};
+  auto prev = std::uint64_t{0U};
+  m.for_each_multi([&](std::uint64_t const i) {
+    EXPECT_TRUE(n_multi == 0U || prev < i);
+    EXPECT_EQ(0U, (i / 1'000U) % 2U);
+    prev = i;
+    ++n_multi;
+  });
+  EXPECT_EQ(kN / 2U, n_multi);
+  EXPECT_FALSE(m.is_multi(1'000U));
+  EXPECT_TRUE(m.is_multi(2'000U));
+  EXPECT_EQ((kN - 1U) * 1'000U + 1U, m.size());
+}
@@ -0,0 +1,58 @@
+#ifdef _WIN32
+#include "windows.h"
+#endif
+
+#include "gtest/gtest.h"
+
+#include <filesystem>
+
+#include "osr/extract/extract.h"
+#include "osr/extract/region.h"
+#include "osr/ways.h"
+
+namespace fs = std::filesystem;
+using namespace osr;
+
+TEST(region, poly) {
+  auto const r = parse_poly(R"(square_with_hole
+1
+   8.0   49.0
+   9.0   49.0
+   9.0   50.0
+   8.0   50.0
+   8.0   49.0
+END
+!2
+   8.4   49.4
+   8.6   49.4
+   8.6   49.6
+   8.4   49.6
+END
+END
+)");
+  EXPECT_TRUE(r.contains({49.2, 8.2}));
+  EXPECT_FALSE(r.contains({49.5, 8.5}));  // hole
+  EXPECT_FALSE(r.contains({50.5, 8.5}));  // outside bbox
+  EXPECT_FALSE(r.contains({49.5, 7.9}));
+
+  auto const b = parse_bbox("8.0,49.0,9.0,50.0");
+  EXPECT_DOUBLE_EQ(49.0, b.min_.lat_);
+  EXPECT_DOUBLE_EQ(9.0, b.max_.lng_);
+  EXPECT_ANY_THROW(parse_bbox("8.0,49.0,9.0"));
+}
+
+TEST(region, extract_bbox) {
+  auto const p = fs::path{"/tmp/osr_region_test"};
+  auto ec = std::error_code{};
+  fs::remove_all(p, ec);
+  fs::create_directories(p, ec);
+
+  osr::extract(extract_options{.bbox_ = parse_bbox(
+                                   "8.6550,49.8815,8.6566,49.8845")},
+               "test/map.osm", p);
+
+  auto const w = ways{p, cista::mmap::protection::READ};
+  EXPECT_TRUE(w.find_way(osm_way_idx_t{3987260}).has_value());  // inside
+  EXPECT_TRUE(w.find_way(osm_way_idx_t{4216959}).has_value());  // crossing
+  EXPECT_FALSE(w.find_way(osm_way_idx_t{140186757}).has_value());  // outside
+}
@@ -0,0 +1,141 @@
+#ifdef _WIN32
+#include "windows.h"
+#endif
+
+#include "gtest/gtest.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "boost/json.hpp"
+
+#include "osr/extract/extract.h"
+#include "osr/extract/synthetic.h"
+#include "osr/lookup.h"
+#include "osr/routing/route.h"
+#include "osr/ways.h"
+
+namespace fs = std::filesystem;
+using namespace osr;
+
+TEST(synthetic, grid) {
+  auto const p = fs::path{"/tmp/osr_synthetic_test"};
+  auto ec = std::error_code{};
+  fs::remove_all(p, ec);
+  fs::create_directories(p, ec);
+
+  auto const opt = synthetic_options{.n_rows_ = 20U,
+                                     .n_cols_ = 20U,
+                                     .delete_probability_ = 0.0,
+                                     .n_buildings_ = 2U,
+                                     .n_restrictions_ = 10U};
+  write_synthetic_osm(opt, p / "synthetic.osm.pbf");
+  osr::extract(false, p / "synthetic.osm.pbf", p / "data");
+
+  auto const w = ways{p / "data", cista::mmap::protection::READ};
+  auto const l = lookup{w, p / "data", cista::mmap::protection::READ};
+
+  // Every intersection is a routing node, building nodes come on top.
+  EXPECT_LT(opt.n_rows_ * opt.n_cols_, w.n_nodes());
+  EXPECT_FALSE(w.r_->multi_level_elevators_.empty());
+
+  // Opposite corners of a grid without deletions are always connected.
+  auto const sw = w.find_node_idx(osm_node_idx_t{1U});
+  auto const ne = w.find_node_idx(osm_node_idx_t{opt.n_rows_ * opt.n_cols_});
+  ASSERT_TRUE(sw.has_value() && ne.has_value());
+  auto const p_car = route(w, l, search_profile::kCar,
+                           location{w.get_node_pos(*sw), kNoLevel},
+                           location{w.get_node_pos(*ne), kNoLevel}, 3600U,
+                           direction::kForward, 100.0);
+  EXPECT_TRUE(p_car.has_value());
+}
+
+TEST(synthetic, extract_profile) {
+  auto const p = fs::path{"/tmp/osr_synthetic_profile_test"};
+  auto ec = std::error_code{};
+  fs::remove_all(p, ec);
+  fs::create_directories(p, ec);
+
+  write_synthetic_osm(synthetic_options{.n_rows_ = 10U, .n_cols_ = 10U},
+                      p / "synthetic.osm.pbf");
+  osr::extract(false, p / "synthetic.osm.pbf", p / "data");
+
+  // Profile report with all phases.
+  auto in = std::ifstream{p / "data" / "extract_profile.json"};
+  auto const report = boost::json::parse(std::string{
+      std::istreambuf_iterator<char>{in}, std::istreambuf_iterator<char>{}});
+  auto phases = std::vector<std::string>{};
+  for (auto const& x : report.at("phases").as_array()) {
+    phases.emplace_back(x.at("name").as_string());
+    EXPECT_LE(0.0, x.at("wall_time_s").to_number<double>());
+  }
+  EXPECT_EQ((std::vector<std::string>{"coordinates", "ways", "connect_ways",
+                                      "node_properties", "restrictions",
+                                      "routing.bin write", "rtree"}),
+            phases);
+}
+
+TEST(synthetic, memory_hint) {
+  auto const p = fs::path{"/tmp/osr_synthetic_hint_test"};
+  auto ec = std::error_code{};
+  fs::remove_all(p, ec);
+  fs::create_directories(p / "a", ec);
+  fs::create_directories(p / "b", ec);
+
+  auto const opt = synthetic_options{.n_rows_ = 10U,
+                                     .n_cols_ = 10U,
+                                     .n_buildings_ = 1U,
+                                     .n_restrictions_ = 5U};
+  write_synthetic_osm(opt, p / "synthetic.osm.pbf");
+  osr::extract(false, p / "synthetic.osm.pbf", p / "a");
+  osr::extract(extract_options{.memory_hint_ = 1U},
+               p / "synthetic.osm.pbf", p / "b");
+
+  // Spilling to disk must not change the result.
+  auto const a = ways{p / "a", cista::mmap::protection::READ};
+  auto const b = ways{p / "b", cista::mmap::protection::READ};
+  ASSERT_EQ(a.n_nodes(), b.n_nodes());
+  ASSERT_EQ(a.n_ways(), b.n_ways());
+  EXPECT_EQ(a.r_->multi_level_elevators_.size(),
+            b.r_->multi_level_elevators_.size());
+  EXPECT_EQ(a.r_->node_restrictions_.data_.size(),
+            b.r_->node_restrictions_.data_.size());
+  for (auto n = node_idx_t{0U}; n != a.n_nodes(); ++n) {
+    EXPECT_EQ(a.r_->node_properties_[n].is_elevator(),
+              b.r_->node_properties_[n].is_elevator());
+  }
+  EXPECT_FALSE(fs::exists(p / "b" / "tmp_staged_nodes.bin"));
+}
+
+TEST(synthetic, node_index) {
+  auto const p = fs::path{"/tmp/osr_synthetic_node_index_test"};
+  auto ec = std::error_code{};
+  fs::remove_all(p, ec);
+  fs::create_directories(p / "a", ec);
+  fs::create_directories(p / "b", ec);
+
+  auto const opt = synthetic_options{.n_rows_ = 10U, .n_cols_ = 10U};
+  write_synthetic_osm(opt, p / "synthetic.osm.pbf");
+  osr::extract(extract_options{.node_index_ = node_index_type::kHybridFile},
+               p / "synthetic.osm.pbf", p / "a");
+  osr::extract(extract_options{.node_index_ = node_index_type::kSparseMem},
+               p / "synthetic.osm.pbf", p / "b");
+
+  // The node coordinate storage must not change the result.
+  auto const a = ways{p / "a", cista::mmap::protection::READ};
+  auto const b = ways{p / "b", cista::mmap::protection::READ};
+  ASSERT_EQ(a.n_ways(), b.n_ways());
+  for (auto way = way_idx_t{0U}; way != a.n_ways(); ++way) {
+    ASSERT_EQ(a.way_polylines_[way].size(), b.way_polylines_[way].size());
+    for (auto i = 0U; i != a.way_polylines_[way].size(); ++i) {
+      EXPECT_EQ(a.way_polylines_[way][i].lat_, b.way_polylines_[way][i].lat_);
+      EXPECT_EQ(a.way_polylines_[way][i].lng_, b.way_polylines_[way][i].lng_);
+    }
+  }
+
+  EXPECT_EQ(node_index_type::kDenseMem, parse_node_index_type("dense-mem"));
+  EXPECT_ANY_THROW(parse_node_index_type("dense"));
+}
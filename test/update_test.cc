@@ -0,0 +1,175 @@
+#ifdef _WIN32
+#include "windows.h"
+#endif
+
+#include "gtest/gtest.h"
+
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include "fmt/core.h"
+
+#include "osr/extract/extract.h"
+#include "osr/extract/update.h"
+#include "osr/lookup.h"
+#include "osr/ways.h"
+
+namespace fs = std::filesystem;
+using namespace osr;
+
+namespace {
+
+void write_file(fs::path const& p, std::string const& content) {
+  auto out = std::ofstream{p};
+  out << content;
+}
+
+}  // namespace
+
+TEST(update, osc) {
+  auto const p = fs::path{"/tmp/osr_update_test"};
+  auto ec = std::error_code{};
+  fs::remove_all(p, ec);
+  fs::create_directories(p, ec);
+
+  osr::extract(false, "test/map.osm", p);
+
+  // Eckhardtstraße: residential -> footway, move its third node north.
+  auto const osm_way = osm_way_idx_t{3987260};
+  auto const moved_node = osm_node_idx_t{4228609249};
+  auto nodes = std::string{};
+  auto old_pos = point{};
+  {
+    auto const w = ways{p, cista::mmap::protection::READ};
+    auto const way = w.find_way(osm_way);
+    ASSERT_TRUE(way.has_value());
+    EXPECT_TRUE(w.r_->way_properties_[*way].is_car_accessible());
+    for (auto const n : w.way_osm_nodes_[*way]) {
+      nodes += fmt::format(R"(<nd ref="{}"/>)", to_idx(n));
+    }
+    ASSERT_EQ(moved_node, w.way_osm_nodes_[*way][2]);
+    old_pos = w.way_polylines_[*way][2];
+  }
+
+  auto const old_latlng = old_pos.as_latlng();
+  write_file(p / "update.osc",
+             fmt::format(R"(<?xml version="1.0" encoding="UTF-8"?>
+<osmChange version="0.6">
+<modify>
+<node id="{}" version="2" lat="{:.7f}" lon="{:.7f}"/>
+<way id="{}" version="12">{}<tag k="highway" v="footway"/></way>
+</modify>
+</osmChange>)",
+                         to_idx(moved_node), old_latlng.lat_ + 0.0002,
+                         old_latlng.lng_, to_idx(osm_way), nodes));
+
+  auto const s = update(p / "update.osc", p);
+  EXPECT_FALSE(s.requires_full_extract());
+  EXPECT_EQ(1U, s.n_way_properties_);
+  EXPECT_EQ(1U, s.n_moved_nodes_);
+  EXPECT_EQ(1U, s.n_geometries_);
+
+  {
+    auto const w = ways{p, cista::mmap::protection::READ};
+    auto const way = w.find_way(osm_way);
+    ASSERT_TRUE(way.has_value());
+    EXPECT_FALSE(w.r_->way_properties_[*way].is_car_accessible());
+    EXPECT_TRUE(w.r_->way_properties_[*way].is_foot_accessible());
+    EXPECT_NEAR(old_latlng.lat_ + 0.0002,
+                w.way_polylines_[*way][2].as_latlng().lat_, 1E-6);
+  }
+
+  // New routable ways change the topology: nothing is written.
+  write_file(p / "new_way.osc", R"(<?xml version="1.0" encoding="UTF-8"?>
+<osmChange version="0.6">
+<create>
+<way id="999999999999" version="1"><nd ref="586157"/><nd ref="586169"/>
+<tag k="highway" v="residential"/></way>
+</create>
+<modify>
+<way id="3987260" version="13"><tag k="highway" v="residential"/></way>
+</modify>
+</osmChange>)");
+
+  auto const s1 = update(p / "new_way.osc", p);
+  EXPECT_TRUE(s1.requires_full_extract());
+  EXPECT_EQ(1U, s1.n_new_ways_);
+  EXPECT_EQ(1U, s1.n_topology_changes_);
+
+  // A way that is not routable anymore is not kept as it was.
+  write_file(p / "untagged.osc",
+             fmt::format(R"(<?xml version="1.0" encoding="UTF-8"?>
+<osmChange version="0.6">
+<modify>
+<way id="{}" version="13">{}<tag k="name" v="Eckhardtstraße"/></way>
+</modify>
+</osmChange>)",
+                         to_idx(osm_way), nodes));
+
+  auto const s2 = update(p / "untagged.osc", p);
+  EXPECT_TRUE(s2.requires_full_extract());
+  EXPECT_EQ(0U, s2.n_way_properties_);
+
+  auto const w = ways{p, cista::mmap::protection::READ};
+  EXPECT_FALSE(w.r_->way_properties_[*w.find_way(osm_way)].is_car_accessible());
+}
+
+TEST(update, packed_geometry) {
+  auto const p = fs::path{"/tmp/osr_update_packed_test"};
+  auto ec = std::error_code{};
+  fs::remove_all(p, ec);
+  fs::create_directories(p, ec);
+
+  osr::extract(extract_options{.pack_geometry_ = true}, "test/map.osm", p);
+
+  auto const osm_way = osm_way_idx_t{3987260};
+  auto const moved_node = osm_node_idx_t{4228609249};
+  auto before = std::vector<std::vector<point>>{};
+  auto old_pos = point{};
+  {
+    auto const w = ways{p, cista::mmap::protection::READ};
+    ASSERT_TRUE(w.is_packed());
+    ASSERT_EQ(0U, w.way_polylines_.size());
+    for (auto way = way_idx_t{0U}; way != w.n_ways(); ++way) {
+      before.emplace_back(w.way_polyline(way));
+    }
+    auto const way = w.find_way(osm_way);
+    ASSERT_TRUE(way.has_value());
+    ASSERT_EQ(moved_node, w.way_osm_nodes(*way)[2]);
+    old_pos = before[to_idx(*way)][2];
+  }
+
+  auto const old_latlng = old_pos.as_latlng();
+  write_file(p / "update.osc",
+             fmt::format(R"(<?xml version="1.0" encoding="UTF-8"?>
+<osmChange version="0.6">
+<modify>
+<node id="{}" version="2" lat="{:.7f}" lon="{:.7f}"/>
+</modify>
+</osmChange>)",
+                         to_idx(moved_node), old_latlng.lat_ + 0.0002,
+                         old_latlng.lng_));
+
+  auto const s = update(p / "update.osc", p);
+  EXPECT_FALSE(s.requires_full_extract());
+  EXPECT_EQ(1U, s.n_geometries_);
+
+  // Only the moved point changes, the following ways are re-appended.
+  auto const w = ways{p, cista::mmap::protection::READ};
+  auto const way = *w.find_way(osm_way);
+  EXPECT_NEAR(old_latlng.lat_ + 0.0002,
+              w.way_polyline(way)[2].as_latlng().lat_, 1E-6);
+  ASSERT_EQ(before.size(), w.n_ways());
+  for (auto x = way_idx_t{0U}; x != w.n_ways(); ++x) {
+    auto const polyline = w.way_polyline(x);
+    ASSERT_EQ(before[to_idx(x)].size(), polyline.size());
+    for (auto i = 0U; i != polyline.size(); ++i) {
+      if (x == way && i == 2U) {
+        continue;
+      }
+      EXPECT_EQ(before[to_idx(x)][i].lat_, polyline[i].lat_);
+      EXPECT_EQ(before[to_idx(x)][i].lng_, polyline[i].lng_);
+    }
+  }
+}